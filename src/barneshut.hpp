@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "materials.hpp"
+#include "memory.hpp"
+#include "scalar.hpp"
+#include "threading.hpp"
+
+// Mutual attraction between all free points in O(N log N). Bodies are sorted along a Morton curve
+// so every quadtree node covers a contiguous range; the 16 subtrees below the second level are
+// built in parallel and spliced under a shared top. A node is treated as one body when its size
+// over its distance is below `theta`. Negative strength makes the force repulsive (like charges).
+template <typename S>
+struct BarnesHutT {
+    struct Node {
+        S comX = S(0), comY = S(0), mass = S(0);
+        S size = S(0);
+        int child[4] = {-1, -1, -1, -1};
+        int begin = 0, end = 0;
+        bool leaf = false;
+    };
+
+    static constexpr int maxLevel = 16;
+    static constexpr int splitLevel = 2;
+
+    bool enabled = false;
+    S theta = S(0.5);
+    S strength = S(1000);
+    S softening = S(5);
+    int leafSize = 8;
+
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::NBody>;
+
+    Vector<S> xs, ys, masses;
+    Vector<uint64_t> keys;
+    Vector<uint32_t> rank;
+    Vector<Node> nodes;
+    Vector<Vector<Node>> subtrees;
+    S minX = S(0), minY = S(0), extent = S(1);
+
+    static uint32_t spread(uint32_t v) {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+
+    static int quadrant(uint64_t key, int level) {
+        return static_cast<int>((key >> (32 + 2 * (maxLevel - 1 - level))) & 3);
+    }
+
+    template <typename PointVector>
+    void build(const PointVector& points, ThreadPool* pool) {
+        size_t n = points.size();
+        nodes.clear();
+        keys.resize(n);
+        xs.resize(n);
+        ys.resize(n);
+        masses.resize(n);
+        rank.resize(n);
+        if (n == 0) return;
+
+        minX = points[0].x;
+        minY = points[0].y;
+        S maxX = minX, maxY = minY;
+        for (const auto& p : points) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        extent = std::max(std::max(maxX - minX, maxY - minY), S(1)) * S(1.001);
+
+        S scale = S(65535) / extent;
+        parallelFor(pool, n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t qx = static_cast<uint32_t>(static_cast<int>((points[i].x - minX) * scale));
+                uint32_t qy = static_cast<uint32_t>(static_cast<int>((points[i].y - minY) * scale));
+                uint64_t code = spread(qx) | (spread(qy) << 1);
+                keys[i] = (code << 32) | static_cast<uint64_t>(i);
+            }
+        });
+        std::sort(keys.begin(), keys.end());
+        parallelFor(pool, n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t index = static_cast<uint32_t>(keys[i]);
+                xs[i] = points[index].x;
+                ys[i] = points[index].y;
+                masses[i] = materialOf(points[index]).mass;
+                rank[index] = static_cast<uint32_t>(i);
+            }
+        });
+
+        constexpr int subtreeCount = 1 << (2 * splitLevel);
+        std::array<int, subtreeCount + 1> bounds;
+        for (int k = 0; k <= subtreeCount; ++k) {
+            uint64_t prefix = static_cast<uint64_t>(k) << (64 - 2 * splitLevel);
+            bounds[k] = k == subtreeCount ? static_cast<int>(n)
+                : static_cast<int>(std::lower_bound(keys.begin(), keys.end(), prefix) - keys.begin());
+        }
+        subtrees.resize(subtreeCount);
+        parallelFor(pool, subtreeCount, [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                subtrees[k].clear();
+                if (bounds[k] == bounds[k + 1]) continue;
+                buildNode(subtrees[k], bounds[k], bounds[k + 1], splitLevel, extent / S(1 << splitLevel));
+            }
+        }, 1);
+
+        // Splice: root, the four second-level nodes, then each subtree with its indices shifted.
+        nodes.resize(5);
+        nodes[0].size = extent;
+        nodes[0].end = static_cast<int>(n);
+        for (int q = 0; q < 4; ++q) {
+            nodes[0].child[q] = 1 + q;
+            nodes[1 + q].size = extent / S(2);
+            nodes[1 + q].begin = bounds[4 * q];
+            nodes[1 + q].end = bounds[4 * q + 4];
+        }
+        for (int k = 0; k < subtreeCount; ++k) {
+            if (subtrees[k].empty()) continue;
+            int offset = static_cast<int>(nodes.size());
+            for (Node node : subtrees[k]) {
+                for (int& c : node.child) if (c >= 0) c += offset;
+                nodes.push_back(node);
+            }
+            nodes[1 + k / 4].child[k % 4] = offset;
+        }
+        for (int q = 4; q >= 0; --q) combineChildren(nodes[q]);
+    }
+
+    void combineChildren(Node& node) const {
+        node.mass = node.comX = node.comY = S(0);
+        for (int c : node.child) {
+            if (c < 0) continue;
+            const Node& child = nodes[c];
+            node.mass += child.mass;
+            node.comX += child.comX * child.mass;
+            node.comY += child.comY * child.mass;
+        }
+        if (node.mass > S(0)) {
+            node.comX /= node.mass;
+            node.comY /= node.mass;
+        }
+    }
+
+    int buildNode(Vector<Node>& out, int begin, int end, int level, S size) {
+        int index = static_cast<int>(out.size());
+        out.emplace_back();
+        out[index].size = size;
+        out[index].begin = begin;
+        out[index].end = end;
+        if (end - begin <= leafSize || level >= maxLevel) {
+            Node& leaf = out[index];
+            leaf.leaf = true;
+            for (int i = begin; i < end; ++i) {
+                leaf.mass += masses[i];
+                leaf.comX += xs[i] * masses[i];
+                leaf.comY += ys[i] * masses[i];
+            }
+            if (leaf.mass > S(0)) {
+                leaf.comX /= leaf.mass;
+                leaf.comY /= leaf.mass;
+            }
+            return index;
+        }
+        int start = begin;
+        for (int q = 0; q < 4; ++q) {
+            int stop = start;
+            while (stop < end && quadrant(keys[stop], level) == q) ++stop;
+            if (stop > start) {
+                int child = buildNode(out, start, stop, level + 1, size / S(2));
+                out[index].child[q] = child;
+            }
+            start = stop;
+        }
+        Node& node = out[index];
+        for (int c : node.child) {
+            if (c < 0) continue;
+            node.mass += out[c].mass;
+            node.comX += out[c].comX * out[c].mass;
+            node.comY += out[c].comY * out[c].mass;
+        }
+        if (node.mass > S(0)) {
+            node.comX /= node.mass;
+            node.comY /= node.mass;
+        }
+        return index;
+    }
+
+    // Acceleration on body `self` (its index in the point vector the tree was built from).
+    void acceleration(S x, S y, uint32_t self, S& ax, S& ay) const {
+        ax = ay = S(0);
+        if (nodes.empty()) return;
+        uint32_t selfRank = rank[self];
+        S softSq = softening * softening;
+        S thetaSq = theta * theta;
+        int stack[4 * maxLevel + 8];
+        int top = 0;
+        stack[top++] = 0;
+        auto pull = [&](S sx, S sy, S mass) {
+            S dx = sx - x, dy = sy - y;
+            S distSq = dx * dx + dy * dy + softSq;
+            S inv = S(1) / scalarSqrt(distSq);
+            S factor = strength * mass * inv * inv * inv;
+            ax += dx * factor;
+            ay += dy * factor;
+        };
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.mass == S(0)) continue;
+            if (node.leaf) {
+                for (int i = node.begin; i < node.end; ++i) {
+                    if (static_cast<uint32_t>(i) != selfRank) pull(xs[i], ys[i], masses[i]);
+                }
+                continue;
+            }
+            S dx = node.comX - x, dy = node.comY - y;
+            S distSq = dx * dx + dy * dy;
+            bool containsSelf = selfRank >= static_cast<uint32_t>(node.begin) && selfRank < static_cast<uint32_t>(node.end);
+            if (!containsSelf && node.size * node.size < thetaSq * distSq) {
+                pull(node.comX, node.comY, node.mass);
+                continue;
+            }
+            for (int c : node.child) if (c >= 0) stack[top++] = c;
+        }
+    }
+};
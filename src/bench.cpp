@@ -0,0 +1,123 @@
+#include "structures.hpp"
+#include "fixed.hpp"
+#include "scenes.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Headless benchmark: runs fixed scenes through the engine and reports the median step time for
+// each scalar instantiation, and with --memory the peak bytes each subsystem held during the run.
+// --jobgraph schedules each step as a job graph and adds the median critical path of its stages.
+// --incremental keeps the broadphase grid between steps and adds the mean shape reinsertions per step.
+// --verlet advances free particles with position Verlet instead of symplectic Euler.
+
+struct BenchResult {
+    double medianMs;
+    double minMs;
+    DiagnosticsT<double> diagnostics;   // after the last step, when measured
+    int64_t peakBytes[memoryTagCount];  // per subsystem, while the scene ran
+    double criticalPathMs;              // median, with --jobgraph
+    char criticalPath[160];             // of the last step
+    double reinsertions;                // mean per step
+};
+
+template <typename S>
+BenchResult runScene(const std::string& scene, int count, int warmup, int steps, ThreadPool& pool, bool deterministic,
+                     bool diagnostics, bool jobGraph, bool incremental, bool verlet) {
+    resetMemoryPeaks();
+    ParticleSystemT<S> world;
+    world.threadPool = &pool;
+    world.deterministicParallel = deterministic;
+    world.diagnosticsEnabled = diagnostics;
+    world.jobGraphEnabled = jobGraph;
+    world.broadphase.incremental = incremental;
+    world.integrator = verlet ? Integrator::Verlet : Integrator::SymplecticEuler;
+    buildScene(world, scene, count);
+    for (int i = 0; i < warmup; ++i) world.update(S(0.016));
+
+    std::vector<double> samples, paths;
+    samples.reserve(steps);
+    paths.reserve(steps);
+    size_t reinsertions = 0;
+    for (int i = 0; i < steps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        world.update(S(0.016));
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        paths.push_back(world.jobGraph.criticalPathMs);
+        reinsertions += world.broadphase.reinsertions;
+    }
+    std::sort(samples.begin(), samples.end());
+    std::sort(paths.begin(), paths.end());
+    const auto& d = world.diagnostics;
+    auto f = [](S v) { return static_cast<double>(v); };
+    BenchResult result{samples[samples.size() / 2], samples.front(),
+                       {f(d.kineticEnergy), f(d.potentialEnergy), f(d.momentumX), f(d.momentumY), f(d.maxConstraintViolation)}, {},
+                       paths[paths.size() / 2], "", static_cast<double>(reinsertions) / steps};
+    for (size_t t = 0; t < memoryTagCount; ++t) result.peakBytes[t] = memoryAccounts[t].peak.load();
+    world.jobGraph.describeCriticalPath(result.criticalPath, sizeof(result.criticalPath));
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int steps = 300;
+    int warmup = 50;
+    unsigned threads = 0;
+    bool deterministic = false;
+    bool diagnostics = false;
+    bool memory = false;
+    bool jobGraph = false;
+    bool incremental = false;
+    bool verlet = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--steps") && i + 1 < argc) steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--warmup") && i + 1 < argc) warmup = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--deterministic")) deterministic = true;
+        else if (!std::strcmp(argv[i], "--diagnostics")) diagnostics = true;
+        else if (!std::strcmp(argv[i], "--memory")) memory = true;
+        else if (!std::strcmp(argv[i], "--jobgraph")) jobGraph = true;
+        else if (!std::strcmp(argv[i], "--incremental")) incremental = true;
+        else if (!std::strcmp(argv[i], "--verlet")) verlet = true;
+    }
+    ThreadPool pool(threads ? threads : std::thread::hardware_concurrency());
+
+    // N-body and fluid constants do not fit the fixed-point range, so those scenes skip it.
+    struct Scene { const char* name; int count; bool fixed; };
+    const Scene scenes[] = {{"particles", 20000, true}, {"shapes", 400, true}, {"crowd", 20000, true}, {"stack", 8, true},
+                            {"nbody", 20000, false}, {"fluid", 5000, false}, {"rope", 1000, true}};
+
+    std::printf("%-12s %8s %14s %14s", "scene", "scalar", "median ms", "min ms");
+    if (diagnostics) std::printf(" %14s %14s %12s %12s %10s", "kinetic E", "potential E", "momentum x", "momentum y", "violation");
+    if (memory) {
+        for (size_t t = 0; t < memoryTagCount; ++t) std::printf(" %11s KB", memoryTagName(static_cast<MemoryTag>(t)));
+    }
+    if (incremental) std::printf(" %14s", "reinserts");
+    if (jobGraph) std::printf(" %14s  %s", "critical ms", "critical path of the last step (ms per stage)");
+    std::printf("\n");
+    auto report = [&](const char* scene, const char* scalar, const BenchResult& r, bool measured) {
+        std::printf("%-12s %8s %14.4f %14.4f", scene, scalar, r.medianMs, r.minMs);
+        const auto& d = r.diagnostics;
+        if (measured) std::printf(" %14.1f %14.1f %12.2f %12.2f %10.5f", d.kineticEnergy, d.potentialEnergy, d.momentumX, d.momentumY, d.maxConstraintViolation);
+        else if (diagnostics) std::printf(" %14s %14s %12s %12s %10s", "", "", "", "", "");
+        if (memory) {
+            for (int64_t bytes : r.peakBytes) std::printf(" %14.1f", static_cast<double>(bytes) / 1024.0);
+        }
+        if (incremental) std::printf(" %14.1f", r.reinsertions);
+        if (jobGraph) std::printf(" %14.4f  %s", r.criticalPathMs, r.criticalPath);
+        std::printf("\n");
+    };
+    for (const auto& scene : scenes) {
+        report(scene.name, "float", runScene<float>(scene.name, scene.count, warmup, steps, pool, deterministic, diagnostics, jobGraph, incremental, verlet), diagnostics);
+        report(scene.name, "double", runScene<double>(scene.name, scene.count, warmup, steps, pool, deterministic, diagnostics, jobGraph, incremental, verlet), diagnostics);
+        if (!scene.fixed) continue;
+        // Whole-scene energy sums overflow Q32.32, so the fixed-point rows are timed without them.
+        report(scene.name, "fixed", runScene<Fixed>(scene.name, scene.count, warmup, steps, pool, deterministic, false, jobGraph, incremental, verlet), false);
+    }
+    return 0;
+}
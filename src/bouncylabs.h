@@ -0,0 +1,74 @@
+#ifndef BOUNCYLABS_H
+#define BOUNCYLABS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* C interface to the engine for hosts that cannot compile against the C++ headers. A world is an
+ * opaque handle; bodies are named by the handle the spawn call returned, 0 meaning none.
+ * Coordinates cross the boundary as float whatever scalar the library was built with.
+ *
+ * Bulk transfers cover the free particles in their current order, which bl_get_handles reports.
+ * Spawning or removing a particle, or a step that culls one, changes that order. Each array
+ * argument may be NULL to skip that field, and each field is copied in a single pass. */
+
+#if defined(_WIN32)
+#  if defined(BOUNCYLABS_BUILD)
+#    define BL_API __declspec(dllexport)
+#  else
+#    define BL_API __declspec(dllimport)
+#  endif
+#else
+#  define BL_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BL_API_VERSION 1
+
+typedef struct bl_world bl_world;
+typedef uint32_t bl_handle;
+
+typedef struct bl_stats {
+    size_t particles;
+    size_t squares;
+    size_t triangles;
+    size_t chains;
+    size_t manifolds;   /* shape contact manifolds found by the last step */
+    uint64_t steps;     /* bl_world_step calls so far */
+    double lastStepMs;  /* wall time of the last bl_world_step call */
+} bl_stats;
+
+BL_API int bl_api_version(void);
+
+/* `threads` is the number of threads one step may use; 0 or 1 steps on the calling thread. */
+BL_API bl_world* bl_world_create(unsigned threads);
+BL_API void bl_world_destroy(bl_world* world);
+
+BL_API void bl_world_step(bl_world* world, float dt);
+BL_API void bl_world_set_gravity(bl_world* world, float strength);
+BL_API void bl_world_set_floor(bl_world* world, float y);
+BL_API void bl_world_add_wall(bl_world* world, float minX, float minY, float maxX, float maxY);
+BL_API void bl_world_get_stats(const bl_world* world, bl_stats* out);
+
+BL_API bl_handle bl_spawn_particle(bl_world* world, float x, float y, float radius, float mass);
+BL_API bl_handle bl_spawn_square(bl_world* world, float x, float y, float side);
+BL_API bl_handle bl_spawn_triangle(bl_world* world, float x, float y, float side);
+BL_API bl_handle bl_spawn_rope(bl_world* world, float x1, float y1, float x2, float y2, int links, int anchored);
+/* Returns 1 when the body existed. */
+BL_API int bl_remove(bl_world* world, bl_handle body);
+
+/* Each returns the number of particles copied: at most `capacity` for gets, `count` for sets. */
+BL_API size_t bl_get_handles(const bl_world* world, bl_handle* handles, size_t capacity);
+BL_API size_t bl_get_positions(const bl_world* world, float* x, float* y, size_t capacity);
+BL_API size_t bl_set_positions(bl_world* world, const float* x, const float* y, size_t count);
+BL_API size_t bl_get_velocities(const bl_world* world, float* vx, float* vy, size_t capacity);
+BL_API size_t bl_set_velocities(bl_world* world, const float* vx, const float* vy, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
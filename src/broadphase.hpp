@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "memory.hpp"
+#include "scalar.hpp"
+#include "threading.hpp"
+
+// Uniform-grid broadphase over axis-aligned boxes. Every box is binned into each cell it touches,
+// then cells are split across threads in contiguous ranges; each thread appends the overlapping
+// pairs of its cells to its own buffer, and the buffers are concatenated in range order. The result
+// is the same cell-by-cell order a single thread would produce, whatever the thread count.
+//
+// In incremental mode each box is binned by a fattened copy instead, and the grid is kept from step
+// to step: only boxes that have left their fat box are taken out of their cells and binned again.
+// Pairs are still tested on the tight boxes, so they are the same pairs a rebuild would find.
+template <typename S>
+struct BroadphaseT {
+    struct Box { S minX, minY, maxX, maxY; };
+    struct Pair { uint32_t a, b; };     // a < b
+
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::Broadphase>;
+
+    Vector<Box> boxes;
+    Vector<Pair> pairs;
+    Vector<uint32_t> cellStart, cellBodies, cursor;
+    Vector<Vector<Pair>> chunkPairs;
+    S originX = S(0), originY = S(0), cellSize = S(1);
+    int cols = 0, rows = 0;
+
+    bool incremental = false;
+    S fatMargin = S(4);             // how far a box may move before it is binned again
+    size_t reinsertions = 0;        // boxes binned by the last findPairs; all of them on a rebuild
+    Vector<Box> fatBoxes;
+    Vector<Vector<uint32_t>> cellLists;
+    Vector<uint32_t> moved;
+    bool binnedIncrementally = false;
+
+    int cellX(S x) const { return std::clamp(static_cast<int>((x - originX) / cellSize), 0, cols - 1); }
+    int cellY(S y) const { return std::clamp(static_cast<int>((y - originY) / cellSize), 0, rows - 1); }
+
+    static bool overlap(const Box& a, const Box& b) {
+        return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+    }
+
+    static bool contains(const Box& outer, const Box& inner) {
+        return outer.minX <= inner.minX && inner.maxX <= outer.maxX && outer.minY <= inner.minY && inner.maxY <= outer.maxY;
+    }
+
+    Box fatten(const Box& b) const { return {b.minX - fatMargin, b.minY - fatMargin, b.maxX + fatMargin, b.maxY + fatMargin}; }
+
+    // Boxes binned into cell c, in index order.
+    std::pair<const uint32_t*, size_t> cell(size_t c) const {
+        if (binnedIncrementally) return {cellLists[c].data(), cellLists[c].size()};
+        return {cellBodies.data() + cellStart[c], cellStart[c + 1] - cellStart[c]};
+    }
+
+    template <typename Fn>
+    void forEachCell(const Box& b, Fn&& fn) const {
+        int x0 = cellX(b.minX), x1 = cellX(b.maxX);
+        for (int y = cellY(b.minY); y <= cellY(b.maxY); ++y) {
+            for (int x = x0; x <= x1; ++x) fn(static_cast<size_t>(y) * cols + x);
+        }
+    }
+
+    // Boxes sharing several cells are reported only from the cell that holds the top-left corner
+    // of their overlap.
+    bool ownsOverlap(const Box& a, const Box& b, int cx, int cy) const {
+        return cellX(std::max(a.minX, b.minX)) == cx && cellY(std::max(a.minY, b.minY)) == cy;
+    }
+
+    // Calls fn(index) once for every box overlapping `area`, using the grid the last `findPairs`
+    // built; with fewer than two boxes there is no grid and every box is tested.
+    template <typename Fn>
+    void query(const Box& area, Fn&& fn) const {
+        if (cols == 0) {
+            for (size_t i = 0; i < boxes.size(); ++i) if (overlap(boxes[i], area)) fn(static_cast<uint32_t>(i));
+            return;
+        }
+        // Clipped to the grid first, so a huge area never reaches the float-to-int conversion.
+        S minX = std::max(area.minX, originX), maxX = std::min(area.maxX, originX + cellSize * S(cols));
+        S minY = std::max(area.minY, originY), maxY = std::min(area.maxY, originY + cellSize * S(rows));
+        if (minX > maxX || minY > maxY) return;
+        int x0 = cellX(minX), x1 = cellX(maxX);
+        for (int cy = cellY(minY); cy <= cellY(maxY); ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                auto [bodies, count] = cell(static_cast<size_t>(cy) * cols + cx);
+                for (size_t k = 0; k < count; ++k) {
+                    uint32_t i = bodies[k];
+                    if (overlap(boxes[i], area) && ownsOverlap(boxes[i], area, cx, cy)) fn(i);
+                }
+            }
+        }
+    }
+
+    // Fills `pairs` with every overlapping pair of `boxes`, ordered by cell and then by index.
+    void findPairs(ThreadPool* pool) {
+        pairs.clear();
+        size_t n = boxes.size();
+        if (n < 2) {
+            cols = rows = 0;
+            fatBoxes.clear();
+            reinsertions = 0;
+            return;
+        }
+        if (incremental) updateCells();
+        else buildCells();
+        collectPairs(pool);
+    }
+
+    // Sizes the grid to cover `source`, widened by `pad` on every side.
+    void fitGrid(const Vector<Box>& source, S pad) {
+        size_t n = source.size();
+        S minX = source[0].minX, minY = source[0].minY, maxX = source[0].maxX, maxY = source[0].maxY;
+        S extent = S(0);
+        for (const Box& b : source) {
+            minX = std::min(minX, b.minX); maxX = std::max(maxX, b.maxX);
+            minY = std::min(minY, b.minY); maxY = std::max(maxY, b.maxY);
+            extent += std::max(b.maxX - b.minX, b.maxY - b.minY);
+        }
+        minX -= pad; minY -= pad;
+        maxX += pad; maxY += pad;
+        // Cells about twice the average box, so most boxes touch one to four of them, grown while
+        // the grid would have far more cells than boxes.
+        cellSize = std::max(S(2) * extent / S(static_cast<int>(n)), S(1));
+        while ((maxX - minX) / cellSize * ((maxY - minY) / cellSize) > S(4 * static_cast<int>(n) + 1024)) cellSize *= S(2);
+        originX = minX;
+        originY = minY;
+        cols = static_cast<int>((maxX - minX) / cellSize) + 1;
+        rows = static_cast<int>((maxY - minY) / cellSize) + 1;
+    }
+
+    bool insideGrid(const Box& b) const {
+        return b.minX >= originX && b.minY >= originY && b.maxX <= originX + cellSize * S(cols) && b.maxY <= originY + cellSize * S(rows);
+    }
+
+    void buildCells() {
+        binnedIncrementally = false;
+        fatBoxes.clear();
+        fitGrid(boxes, S(0));
+        size_t n = boxes.size();
+        size_t cells = static_cast<size_t>(cols) * rows;
+        cellStart.assign(cells + 1, 0);
+        for (const Box& b : boxes) forEachCell(b, [&](size_t c) { ++cellStart[c + 1]; });
+        for (size_t c = 0; c < cells; ++c) cellStart[c + 1] += cellStart[c];
+        cellBodies.resize(cellStart[cells]);
+        cursor.assign(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < n; ++i) {
+            forEachCell(boxes[i], [&](size_t c) { cellBodies[cursor[c]++] = static_cast<uint32_t>(i); });
+        }
+        reinsertions = n;
+    }
+
+    // Bins again only the boxes that left their fat box. Everything is rebuilt when the box count
+    // changed, when a box moves off the grid, or when more than a quarter moved, which the full
+    // rebuild handles faster and which recentres the grid.
+    void updateCells() {
+        size_t n = boxes.size();
+        bool rebuild = !binnedIncrementally || fatBoxes.size() != n;
+        moved.clear();
+        for (uint32_t i = 0; i < n && !rebuild; ++i) {
+            if (contains(fatBoxes[i], boxes[i])) continue;
+            moved.push_back(i);
+            rebuild = moved.size() * 4 > n || !insideGrid(fatten(boxes[i]));
+        }
+        if (rebuild) {
+            binnedIncrementally = true;
+            fatBoxes.resize(n);
+            for (size_t i = 0; i < n; ++i) fatBoxes[i] = fatten(boxes[i]);
+            fitGrid(fatBoxes, S(4) * fatMargin);
+            cellLists.resize(static_cast<size_t>(cols) * rows);
+            for (auto& list : cellLists) list.clear();
+            for (size_t i = 0; i < n; ++i) forEachCell(fatBoxes[i], [&](size_t c) { cellLists[c].push_back(static_cast<uint32_t>(i)); });
+            reinsertions = n;
+            return;
+        }
+        for (uint32_t i : moved) {
+            forEachCell(fatBoxes[i], [&](size_t c) {
+                auto& list = cellLists[c];
+                list.erase(std::lower_bound(list.begin(), list.end(), i));
+            });
+            fatBoxes[i] = fatten(boxes[i]);
+            forEachCell(fatBoxes[i], [&](size_t c) {
+                auto& list = cellLists[c];
+                list.insert(std::lower_bound(list.begin(), list.end(), i), i);
+            });
+        }
+        reinsertions = moved.size();
+    }
+
+    void collectPairs(ThreadPool* pool) {
+        size_t cells = static_cast<size_t>(cols) * rows;
+        chunkPairs.resize(pool ? pool->size() : 1);
+        for (auto& part : chunkPairs) part.clear();
+        parallelFor(pool, cells, [&](size_t begin, size_t end, unsigned chunk) {
+            auto& out = chunkPairs[chunk];
+            for (size_t c = begin; c < end; ++c) {
+                int cx = static_cast<int>(c % cols), cy = static_cast<int>(c / cols);
+                auto [bodies, count] = cell(c);
+                for (size_t k = 0; k < count; ++k) {
+                    uint32_t a = bodies[k];
+                    const Box& boxA = boxes[a];
+                    for (size_t m = k + 1; m < count; ++m) {
+                        uint32_t b = bodies[m];
+                        const Box& boxB = boxes[b];
+                        if (!overlap(boxA, boxB) || !ownsOverlap(boxA, boxB, cx, cy)) continue;
+                        out.push_back({a, b});
+                    }
+                }
+            }
+        }, 64);
+
+        size_t total = 0;
+        for (const auto& part : chunkPairs) total += part.size();
+        pairs.resize(total);
+        size_t at = 0;
+        for (const auto& part : chunkPairs) {
+            std::copy(part.begin(), part.end(), pairs.begin() + at);
+            at += part.size();
+        }
+    }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// 2D view onto the world: (centerX, centerY) sits in the middle of a width×height pixel viewport,
+// and one world unit covers `zoom` pixels. Screen and world share orientation (y points down).
+struct Camera2D {
+    float centerX = 640.0f, centerY = 360.0f;
+    float zoom = 1.0f;
+    float width = 1280.0f, height = 720.0f;
+    float minZoom = 0.05f, maxZoom = 20.0f;
+
+    float toScreenX(float x) const { return (x - centerX) * zoom + width * 0.5f; }
+    float toScreenY(float y) const { return (y - centerY) * zoom + height * 0.5f; }
+    float toWorldX(float sx) const { return (sx - width * 0.5f) / zoom + centerX; }
+    float toWorldY(float sy) const { return (sy - height * 0.5f) / zoom + centerY; }
+
+    // World rectangle currently on screen.
+    float visibleMinX() const { return toWorldX(0.0f); }
+    float visibleMinY() const { return toWorldY(0.0f); }
+    float visibleMaxX() const { return toWorldX(width); }
+    float visibleMaxY() const { return toWorldY(height); }
+
+    // Moves the view by a drag of (dx, dy) pixels, so the world follows the cursor.
+    void pan(float dx, float dy) {
+        centerX -= dx / zoom;
+        centerY -= dy / zoom;
+    }
+
+    // Scales the zoom by `factor`, keeping the world point under (sx, sy) fixed on screen.
+    void zoomAt(float sx, float sy, float factor) {
+        float wx = toWorldX(sx), wy = toWorldY(sy);
+        zoom = std::clamp(zoom * factor, minZoom, maxZoom);
+        centerX = wx - (sx - width * 0.5f) / zoom;
+        centerY = wy - (sy - height * 0.5f) / zoom;
+    }
+
+    // Eases the centre towards (x, y); `rate` is the fraction of the distance closed per second.
+    void follow(float x, float y, float rate, float dt) {
+        float t = 1.0f - std::pow(1.0f - std::clamp(rate, 0.0f, 1.0f), dt);
+        centerX += (x - centerX) * t;
+        centerY += (y - centerY) * t;
+    }
+};
@@ -0,0 +1,146 @@
+#define BOUNCYLABS_BUILD
+#include "bouncylabs.h"
+#include "scenes.hpp"
+#include <chrono>
+#include <memory>
+
+struct bl_world {
+    ParticleSystem system;
+    std::unique_ptr<ThreadPool> pool;
+    uint64_t steps = 0;
+    double lastStepMs = 0.0;
+};
+
+namespace {
+
+// One pass over the particles per field; points are stored as structs, so a field is strided.
+template <typename Points, typename Field>
+size_t copyOut(const Points& points, Field field, float* out, size_t capacity) {
+    size_t n = std::min(points.size(), capacity);
+    if (out) for (size_t i = 0; i < n; ++i) out[i] = static_cast<float>(points[i].*field);
+    return n;
+}
+
+template <typename Points, typename Field>
+size_t copyIn(Points& points, Field field, const float* in, size_t count) {
+    size_t n = std::min(points.size(), count);
+    if (in) for (size_t i = 0; i < n; ++i) points[i].*field = Real(in[i]);
+    return n;
+}
+
+}  // namespace
+
+extern "C" {
+
+int bl_api_version(void) { return BL_API_VERSION; }
+
+bl_world* bl_world_create(unsigned threads) {
+    auto* world = new bl_world;
+    if (threads > 1) {
+        world->pool = std::make_unique<ThreadPool>(threads);
+        world->system.threadPool = world->pool.get();
+    }
+    return world;
+}
+
+void bl_world_destroy(bl_world* world) { delete world; }
+
+void bl_world_step(bl_world* world, float dt) {
+    auto start = std::chrono::steady_clock::now();
+    world->system.update(Real(dt));
+    world->lastStepMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    ++world->steps;
+}
+
+void bl_world_set_gravity(bl_world* world, float strength) {
+    for (auto& field : world->system.forceFields) {
+        if (field.type == ForceType::Gravity) {
+            field.strength = Real(strength);
+            return;
+        }
+    }
+    world->system.addForceField(ForceFieldT<Real>::gravity(Real(strength)));
+}
+
+void bl_world_set_floor(bl_world* world, float y) { world->system.floorY = Real(y); }
+
+void bl_world_add_wall(bl_world* world, float minX, float minY, float maxX, float maxY) {
+    world->system.staticGeometry.addWall(Real(minX), Real(minY), Real(maxX), Real(maxY));
+}
+
+void bl_world_get_stats(const bl_world* world, bl_stats* out) {
+    const ParticleSystem& s = world->system;
+    out->particles = s.points.size();
+    out->squares = s.squares.size();
+    out->triangles = s.triangles.size();
+    out->chains = s.chains.size();
+    out->manifolds = s.manifolds.size();
+    out->steps = world->steps;
+    out->lastStepMs = world->lastStepMs;
+}
+
+bl_handle bl_spawn_particle(bl_world* world, float x, float y, float radius, float mass) {
+    Point p{Real(x), Real(y), Real(radius), Real(0), Real(0)};
+    MaterialT<Real> material;
+    material.mass = Real(mass);
+    p.material = addMaterial(material);
+    return world->system.add(p);
+}
+
+bl_handle bl_spawn_square(bl_world* world, float x, float y, float side) {
+    return world->system.addSquare(makeSquare(Real(x), Real(y), Real(side)));
+}
+
+bl_handle bl_spawn_triangle(bl_world* world, float x, float y, float side) {
+    return world->system.addTriangle(makeTriangle(Real(x), Real(y), Real(side)));
+}
+
+bl_handle bl_spawn_rope(bl_world* world, float x1, float y1, float x2, float y2, int links, int anchored) {
+    return world->system.addChain(Chain::between(Real(x1), Real(y1), Real(x2), Real(y2), links, Real(2), anchored != 0));
+}
+
+int bl_remove(bl_world* world, bl_handle body) { return world->system.remove(body) ? 1 : 0; }
+
+size_t bl_get_handles(const bl_world* world, bl_handle* handles, size_t capacity) {
+    const auto& points = world->system.points;
+    size_t n = std::min(points.size(), capacity);
+    if (handles) for (size_t i = 0; i < n; ++i) handles[i] = points[i].id;
+    return n;
+}
+
+size_t bl_get_positions(const bl_world* world, float* x, float* y, size_t capacity) {
+    copyOut(world->system.points, &Point::x, x, capacity);
+    return copyOut(world->system.points, &Point::y, y, capacity);
+}
+
+// In Verlet mode the particles hold previous positions rather than velocities; the setters switch
+// them back to velocities, which keeps those intact, and the next step switches them again.
+size_t bl_set_positions(bl_world* world, const float* x, const float* y, size_t count) {
+    if (world->system.pointsHoldPrevious) world->system.storeVelocities();
+    copyIn(world->system.points, &Point::x, x, count);
+    return copyIn(world->system.points, &Point::y, y, count);
+}
+
+size_t bl_get_velocities(const bl_world* world, float* vx, float* vy, size_t capacity) {
+    const ParticleSystem& s = world->system;
+    if (!s.pointsHoldPrevious) {
+        copyOut(s.points, &Point::vx, vx, capacity);
+        return copyOut(s.points, &Point::vy, vy, capacity);
+    }
+    size_t n = std::min(s.points.size(), capacity);
+    for (size_t i = 0; i < n; ++i) {
+        Real pvx, pvy;
+        s.velocityOf(s.points[i], pvx, pvy);
+        if (vx) vx[i] = static_cast<float>(pvx);
+        if (vy) vy[i] = static_cast<float>(pvy);
+    }
+    return n;
+}
+
+size_t bl_set_velocities(bl_world* world, const float* vx, const float* vy, size_t count) {
+    if (world->system.pointsHoldPrevious) world->system.storeVelocities();
+    copyIn(world->system.points, &Point::vx, vx, count);
+    return copyIn(world->system.points, &Point::vy, vy, count);
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include "scalar.hpp"
+#include "contacts.hpp"
+#include "memory.hpp"
+
+// Thomas algorithm for a tridiagonal system, solved in place: on return `rhs` holds the solution.
+// `lower[0]` and `upper[n - 1]` are ignored. `scratch` needs room for n values.
+template <typename S>
+void solveTridiagonal(const S* lower, const S* diag, const S* upper, S* rhs, S* scratch, size_t n) {
+    if (n == 0) return;
+    scratch[0] = upper[0] / diag[0];
+    rhs[0] = rhs[0] / diag[0];
+    for (size_t i = 1; i < n; ++i) {
+        S denom = diag[i] - lower[i] * scratch[i - 1];
+        scratch[i] = upper[i] / denom;
+        rhs[i] = (rhs[i] - lower[i] * rhs[i - 1]) / denom;
+    }
+    for (size_t i = n - 1; i-- > 0;) rhs[i] -= scratch[i] * rhs[i + 1];
+}
+
+// Keeps every link of a chain at its rest length with direct solves. The links only couple to
+// their neighbours, so J W J^T is tridiagonal and one O(n) solve replaces the hundreds of
+// Gauss-Seidel sweeps a long rope would need. A step first removes the stretching velocity at the
+// start-of-step configuration, re-advances the positions with it, and then projects the remaining
+// second-order drift; further iterations are extra Newton steps on the nonlinear lengths.
+template <typename S>
+struct ChainSolverT {
+    TaggedVector<S, MemoryTag::ChainSolver> nx, ny, length, lower, diag, upper, lambda, scratch, weight;
+
+    template <typename PointVector>
+    void computeLinks(const PointVector& points, size_t links) {
+        for (size_t i = 0; i < links; ++i) {
+            S dx = points[i + 1].x - points[i].x, dy = points[i + 1].y - points[i].y;
+            S len = scalarSqrt(dx * dx + dy * dy);
+            length[i] = len;
+            nx[i] = len > S(0) ? dx / len : S(1);
+            ny[i] = len > S(0) ? dy / len : S(0);
+        }
+    }
+
+    // Solves (J W J^T) lambda = rhs in place, with rhs preloaded into `lambda`.
+    void solve(size_t links) {
+        for (size_t i = 0; i < links; ++i) {
+            diag[i] = weight[i] + weight[i + 1];
+            lower[i] = i > 0 ? -weight[i] * (nx[i - 1] * nx[i] + ny[i - 1] * ny[i]) : S(0);
+            upper[i] = i + 1 < links ? -weight[i + 1] * (nx[i] * nx[i + 1] + ny[i] * ny[i + 1]) : S(0);
+            // A link between two immovable points cannot be corrected; pin its multiplier to 0.
+            if (diag[i] == S(0)) { diag[i] = S(1); lower[i] = upper[i] = lambda[i] = S(0); }
+        }
+        solveTridiagonal(lower.data(), diag.data(), upper.data(), lambda.data(), scratch.data(), links);
+    }
+
+    // W J^T lambda for point j: w_j (lambda_{j-1} n_{j-1} - lambda_j n_j).
+    void correction(size_t j, size_t links, S& cx, S& cy) const {
+        cx = cy = S(0);
+        if (j > 0) { cx += lambda[j - 1] * nx[j - 1]; cy += lambda[j - 1] * ny[j - 1]; }
+        if (j < links) { cx -= lambda[j] * nx[j]; cy -= lambda[j] * ny[j]; }
+        cx *= weight[j];
+        cy *= weight[j];
+    }
+
+    // `startX`/`startY` hold the positions before this step's integration.
+    template <typename PointVector, typename ScalarVector>
+    void step(PointVector& points, const ScalarVector& startX, const ScalarVector& startY,
+              const ScalarVector& restLengths, int iterations, S dt) {
+        size_t links = restLengths.size();
+        if (links == 0 || points.size() != links + 1 || dt <= S(0)) return;
+        nx.resize(links); ny.resize(links); length.resize(links);
+        lower.resize(links); diag.resize(links); upper.resize(links);
+        lambda.resize(links); scratch.resize(links);
+        weight.resize(links + 1);
+        for (size_t i = 0; i <= links; ++i) weight[i] = inverseMass(points[i]);
+
+        for (size_t i = 0; i < links; ++i) {
+            S dx = startX[i + 1] - startX[i], dy = startY[i + 1] - startY[i];
+            S len = scalarSqrt(dx * dx + dy * dy);
+            nx[i] = len > S(0) ? dx / len : S(1);
+            ny[i] = len > S(0) ? dy / len : S(0);
+            lambda[i] = -(nx[i] * (points[i + 1].vx - points[i].vx) + ny[i] * (points[i + 1].vy - points[i].vy));
+        }
+        solve(links);
+        for (size_t j = 0; j <= links; ++j) {
+            if (weight[j] == S(0)) continue;
+            S cx, cy;
+            correction(j, links, cx, cy);
+            points[j].vx += cx;
+            points[j].vy += cy;
+            points[j].x = startX[j] + points[j].vx * dt;
+            points[j].y = startY[j] + points[j].vy * dt;
+        }
+
+        S invDt = S(1) / dt;
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            computeLinks(points, links);
+            for (size_t i = 0; i < links; ++i) lambda[i] = restLengths[i] - length[i];
+            solve(links);
+            for (size_t j = 0; j <= links; ++j) {
+                if (weight[j] == S(0)) continue;
+                S cx, cy;
+                correction(j, links, cx, cy);
+                points[j].x += cx;
+                points[j].y += cy;
+                points[j].vx += cx * invDt;
+                points[j].vy += cy * invDt;
+            }
+        }
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include "scalar.hpp"
+
+template <typename P>
+using ScalarOf = typename P::Scalar;
+
+// A point of the incident polygon pushed into an edge of the reference polygon. It lies `s` of the
+// way along the incident edge from `vertex` to `vertexEnd` (the same point twice for a lone
+// corner), and projects `t` of the way along the reference edge.
+// `feature` identifies the edge/edge combination so the contact can be matched next step.
+template <typename P>
+struct Contact {
+    using S = ScalarOf<P>;
+
+    P* vertex;
+    P* vertexEnd;
+    S s;
+    P* edgeStart;
+    P* edgeEnd;
+    S t;
+    S depth;
+    int feature = 0;
+    S normalImpulse = S(0);
+    S tangentImpulse = S(0);
+    S velocityBias = S(0);
+    // Filled in by the solver: offsets of the contact from each body's centroid, and the
+    // effective masses along the normal and the tangent.
+    S vertexArmX = S(0), vertexArmY = S(0), edgeArmX = S(0), edgeArmY = S(0);
+    S normalMass = S(0), tangentMass = S(0);
+};
+
+template <typename P>
+struct Manifold {
+    using S = ScalarOf<P>;
+
+    S normalX = S(0), normalY = S(0);
+    int count = 0;
+    Contact<P> contacts[2];
+    bool flipped = false;           // the reference edge is on the second polygon
+    uint32_t vertexBody = 0, edgeBody = 0;  // set by the caller, which knows the body numbering
+};
+
+template <typename P>
+inline ScalarOf<P> signedArea(P* const* poly, int n) {
+    using S = ScalarOf<P>;
+    S area = S(0);
+    for (int i = 0; i < n; ++i) {
+        const P* a = poly[i];
+        const P* b = poly[(i + 1) % n];
+        area += a->x * b->y - b->x * a->y;
+    }
+    return area;
+}
+
+template <typename P>
+inline bool aabbOverlap(P* const* a, int na, P* const* b, int nb, ScalarOf<P> margin = ScalarOf<P>(0)) {
+    using S = ScalarOf<P>;
+    S aMinX = a[0]->x, aMaxX = a[0]->x, aMinY = a[0]->y, aMaxY = a[0]->y;
+    for (int i = 1; i < na; ++i) {
+        aMinX = std::min(aMinX, a[i]->x); aMaxX = std::max(aMaxX, a[i]->x);
+        aMinY = std::min(aMinY, a[i]->y); aMaxY = std::max(aMaxY, a[i]->y);
+    }
+    aMinX -= margin; aMinY -= margin;
+    aMaxX += margin; aMaxY += margin;
+    for (int i = 0; i < nb; ++i) {
+        if (b[i]->x >= aMinX && b[i]->x <= aMaxX && b[i]->y >= aMinY && b[i]->y <= aMaxY) return true;
+    }
+    S bMinX = b[0]->x, bMaxX = b[0]->x, bMinY = b[0]->y, bMaxY = b[0]->y;
+    for (int i = 1; i < nb; ++i) {
+        bMinX = std::min(bMinX, b[i]->x); bMaxX = std::max(bMaxX, b[i]->x);
+        bMinY = std::min(bMinY, b[i]->y); bMaxY = std::max(bMaxY, b[i]->y);
+    }
+    return aMinX <= bMaxX && bMinX <= aMaxX && aMinY <= bMaxY && bMinY <= aMaxY;
+}
+
+// Largest separation of `b` along the outward edge normals of `a`. Returns as soon as a separating
+// axis is found, since then the polygons cannot touch.
+template <typename P>
+inline ScalarOf<P> maxSeparation(P* const* a, int na, P* const* b, int nb, int& bestEdge) {
+    using S = ScalarOf<P>;
+    S orientation = signedArea(a, na) >= S(0) ? S(1) : S(-1);
+    S best = std::numeric_limits<S>::lowest();
+    bestEdge = -1;
+    for (int i = 0; i < na; ++i) {
+        const P* p1 = a[i];
+        const P* p2 = a[(i + 1) % na];
+        S nx = (p2->y - p1->y) * orientation;
+        S ny = -(p2->x - p1->x) * orientation;
+        S len = scalarSqrt(nx * nx + ny * ny);
+        if (len == S(0)) continue;
+        nx /= len;
+        ny /= len;
+        S minProj = std::numeric_limits<S>::max();
+        for (int j = 0; j < nb; ++j) {
+            minProj = std::min(minProj, (b[j]->x - p1->x) * nx + (b[j]->y - p1->y) * ny);
+        }
+        if (minProj > best) {
+            best = minProj;
+            bestEdge = i;
+            if (best > S(0)) return best;
+        }
+    }
+    return best;
+}
+
+// The incident edge is the one facing most directly against the reference edge. It is clipped to
+// the span of the reference edge and each end that is within `margin` of the reference edge
+// becomes a contact, so two faces lying on each other always get a contact at each end of their
+// overlap, even when one overhangs the other.
+template <typename P>
+inline void buildManifold(P* const* ref, int nr, int edge, P* const* inc, int ni, bool flipped, ScalarOf<P> margin, Manifold<P>& m) {
+    using S = ScalarOf<P>;
+    P* a = ref[edge];
+    P* b = ref[(edge + 1) % nr];
+    S orientation = signedArea(ref, nr) >= S(0) ? S(1) : S(-1);
+    S ex = b->x - a->x, ey = b->y - a->y;
+    S lenSq = ex * ex + ey * ey;
+    S len = scalarSqrt(lenSq);
+    m.normalX = ey * orientation / len;
+    m.normalY = -ex * orientation / len;
+    m.count = 0;
+    m.flipped = flipped;
+
+    S incidentOrientation = signedArea(inc, ni) >= S(0) ? S(1) : S(-1);
+    int incident = 0;
+    S mostOpposed = std::numeric_limits<S>::max();
+    for (int i = 0; i < ni; ++i) {
+        const P* p1 = inc[i];
+        const P* p2 = inc[(i + 1) % ni];
+        S facing = ((p2->y - p1->y) * m.normalX - (p2->x - p1->x) * m.normalY) * incidentOrientation;
+        S length = scalarSqrt((p2->x - p1->x) * (p2->x - p1->x) + (p2->y - p1->y) * (p2->y - p1->y));
+        if (length == S(0)) continue;
+        facing /= length;
+        if (facing < mostOpposed) {
+            mostOpposed = facing;
+            incident = i;
+        }
+    }
+    P* i1 = inc[incident];
+    P* i2 = inc[(incident + 1) % ni];
+    auto along = [&](S x, S y) { return ((x - a->x) * ex + (y - a->y) * ey) / lenSq; };
+    S u1 = along(i1->x, i1->y), u2 = along(i2->x, i2->y);
+    S lo = S(0), hi = S(1);
+    if (u1 != u2) {
+        S s0 = (S(0) - u1) / (u2 - u1), s1 = (S(1) - u1) / (u2 - u1);
+        lo = std::max(lo, std::min(s0, s1));
+        hi = std::min(hi, std::max(s0, s1));
+    } else if (u1 < S(0) || u1 > S(1)) {
+        return;
+    }
+    if (lo > hi) return;
+    const S ends[2] = {lo, hi};
+    for (int k = 0; k < 2; ++k) {
+        S s = ends[k];
+        if (k == 1 && hi == lo) break;
+        S x = i1->x + (i2->x - i1->x) * s, y = i1->y + (i2->y - i1->y) * s;
+        S sep = (x - a->x) * m.normalX + (y - a->y) * m.normalY;
+        if (sep >= margin) continue;
+        S t = std::max(S(0), std::min(S(1), along(x, y)));
+        m.contacts[m.count++] = Contact<P>{i1, i2, s, a, b, t, -sep, (flipped ? 1 << 16 : 0) | (edge << 8) | (incident << 1) | k};
+    }
+}
+
+// Separating axis test between two convex polygons with any number of vertices. On overlap the
+// manifold holds up to two incident vertices and the normal points out of the reference polygon.
+// Pairs closer than `margin` also produce contacts (with negative depth) so resting contacts do not
+// flicker in and out of existence between steps.
+template <typename P>
+inline bool collidePolygons(P* const* a, int na, P* const* b, int nb, Manifold<P>& m, ScalarOf<P> margin = ScalarOf<P>(0)) {
+    using S = ScalarOf<P>;
+    m.count = 0;
+    if (!aabbOverlap(a, na, b, nb, margin)) return false;
+    int edgeA, edgeB;
+    S sepA = maxSeparation(a, na, b, nb, edgeA);
+    if (sepA > margin || edgeA < 0) return false;
+    S sepB = maxSeparation(b, nb, a, na, edgeB);
+    if (sepB > margin || edgeB < 0) return false;
+    // Prefer A as the reference polygon unless B is clearly better, to avoid flip-flopping.
+    if (sepB > sepA + S(0.1)) buildManifold(b, nb, edgeB, a, na, true, margin, m);
+    else buildManifold(a, na, edgeA, b, nb, false, margin, m);
+    return m.count > 0;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <variant>
+#include "structures.hpp"
+
+// Typed edits to a world. The UI never touches the world itself: it queues these, and the
+// simulation applies them all at the start of its next step. Bodies are named by the handle
+// `add*` returned; a command naming a body that has since been culled or deleted does nothing.
+using BodyHandle = uint32_t;
+
+template <typename S>
+struct SpawnParticleT {
+    PointT<S> particle;
+};
+
+// `count` copies of `particle`, laid out row by row, `columns` per row and `spacing` apart.
+template <typename S>
+struct SpawnParticleGridT {
+    PointT<S> particle;
+    int columns = 1;
+    int count = 1;
+    S spacing = S(1);
+};
+
+template <typename S>
+struct SpawnSquareT {
+    SquareT<S> square;
+};
+
+template <typename S>
+struct SpawnTriangleT {
+    TriangleT<S> triangle;
+};
+
+template <typename S>
+struct SpawnRopeT {
+    S x1, y1, x2, y2;
+    int links = 1;
+    S radius = S(2);
+    bool anchored = true;
+};
+
+struct DeleteBody {
+    BodyHandle handle = 0;
+};
+
+// Grabs one vertex of a body at the cursor position (x, y); it follows UpdateDrag until EndDrag.
+template <typename S>
+struct BeginDragT {
+    BodyHandle handle = 0;
+    uint32_t vertex = 0;
+    S x, y;
+};
+
+template <typename S>
+struct UpdateDragT {
+    S x, y;
+};
+
+struct EndDrag {};
+
+template <typename S>
+struct SetForceFieldT {
+    size_t handle = 0;
+    ForceFieldT<S> field;
+};
+
+template <typename S>
+struct SetParametersT {
+    S floorY = S(720);
+    int solverIterations = 4;
+    int substeps = 1;
+    bool warmStarting = true;
+    BoundsPolicy boundsPolicy = BoundsPolicy::Cull;
+    bool nbodyEnabled = false;
+    S nbodyStrength = S(1000);
+    S nbodyTheta = S(0.5);
+    bool fluidEnabled = false;
+    S fluidStiffness = S(40000);
+    S fluidViscosity = S(10);
+    bool diagnosticsEnabled = false;
+    bool jobGraphEnabled = false;
+    bool incrementalBroadphase = false;
+    Integrator integrator = Integrator::SymplecticEuler;
+};
+
+// The world rectangle the renderer shows. Snapshots only carry the bodies that overlap it, and
+// particles smaller than `splatRadius` go into a density grid of `splatCell`-sized cells instead.
+template <typename S>
+struct SetViewT {
+    S minX = std::numeric_limits<S>::lowest(), minY = std::numeric_limits<S>::lowest();
+    S maxX = std::numeric_limits<S>::max(), maxY = std::numeric_limits<S>::max();
+    S splatRadius = S(0);
+    S splatCell = S(0);
+};
+
+template <typename S>
+using CommandT = std::variant<SpawnParticleT<S>, SpawnParticleGridT<S>, SpawnSquareT<S>, SpawnTriangleT<S>,
+                              SpawnRopeT<S>, DeleteBody, BeginDragT<S>, UpdateDragT<S>, EndDrag,
+                              SetForceFieldT<S>, SetParametersT<S>, SetViewT<S>>;
+
+// Applies commands to a world, remembering which body is being dragged and what is in view
+// between them.
+template <typename S>
+struct CommandProcessorT {
+    using World = ParticleSystemT<S>;
+    using Point = PointT<S>;
+
+    BodyHandle dragHandle = 0;
+    SetViewT<S> view;
+
+    void apply(World& world, const CommandT<S>& command) {
+        std::visit([&](const auto& c) { handle(world, c); }, command);
+    }
+
+    void handle(World& world, const SpawnParticleT<S>& c) { world.add(c.particle); }
+
+    void handle(World& world, const SpawnParticleGridT<S>& c) {
+        int columns = std::max(c.columns, 1);
+        for (int i = 0; i < c.count; ++i) {
+            Point p = c.particle;
+            p.x += c.spacing * S(i % columns);
+            p.y += c.spacing * S(i / columns);
+            world.add(p);
+        }
+    }
+
+    void handle(World& world, const SpawnSquareT<S>& c) { world.addSquare(c.square); }
+    void handle(World& world, const SpawnTriangleT<S>& c) { world.addTriangle(c.triangle); }
+
+    void handle(World& world, const SpawnRopeT<S>& c) {
+        world.addChain(ChainT<S>::between(c.x1, c.y1, c.x2, c.y2, c.links, c.radius, c.anchored));
+    }
+
+    void handle(World& world, const DeleteBody& c) {
+        if (c.handle == dragHandle) dragHandle = 0;
+        world.remove(c.handle);
+    }
+
+    void handle(World& world, const BeginDragT<S>& c) {
+        handle(world, EndDrag{});
+        if (world.beginDrag(c.handle, c.vertex, c.x, c.y)) dragHandle = c.handle;
+    }
+
+    void handle(World& world, const UpdateDragT<S>& c) {
+        if (dragHandle) world.updateDrag(dragHandle, c.x, c.y);
+    }
+
+    void handle(World& world, const EndDrag&) {
+        if (dragHandle) world.endDrag(dragHandle);
+        dragHandle = 0;
+    }
+
+    void handle(World& world, const SetForceFieldT<S>& c) {
+        if (c.handle < world.forceFields.size()) world.forceField(c.handle) = c.field;
+    }
+
+    void handle(World& world, const SetParametersT<S>& c) {
+        world.floorY = c.floorY;
+        world.solverIterations = c.solverIterations;
+        world.substeps = c.substeps;
+        world.warmStarting = c.warmStarting;
+        world.bounds.policy = c.boundsPolicy;
+        world.nbody.enabled = c.nbodyEnabled;
+        world.nbody.strength = c.nbodyStrength;
+        world.nbody.theta = c.nbodyTheta;
+        world.fluid.enabled = c.fluidEnabled;
+        world.fluid.stiffness = c.fluidStiffness;
+        world.fluid.viscosity = c.fluidViscosity;
+        world.diagnosticsEnabled = c.diagnosticsEnabled;
+        world.jobGraphEnabled = c.jobGraphEnabled;
+        world.broadphase.incremental = c.incrementalBroadphase;
+        world.integrator = c.integrator;
+    }
+
+    void handle(World&, const SetViewT<S>& c) { view = c; }
+};
+
+using SpawnParticle = SpawnParticleT<Real>;
+using SpawnParticleGrid = SpawnParticleGridT<Real>;
+using SpawnSquare = SpawnSquareT<Real>;
+using SpawnTriangle = SpawnTriangleT<Real>;
+using SpawnRope = SpawnRopeT<Real>;
+using BeginDrag = BeginDragT<Real>;
+using UpdateDrag = UpdateDragT<Real>;
+using SetForceField = SetForceFieldT<Real>;
+using SetParameters = SetParametersT<Real>;
+using SetView = SetViewT<Real>;
+using Command = CommandT<Real>;
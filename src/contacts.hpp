@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include "collision.hpp"
+#include "materials.hpp"
+#include "memory.hpp"
+
+template <typename S>
+struct CachedContactT {
+    int feature;
+    S normalImpulse;
+    S tangentImpulse;
+};
+
+template <typename S>
+struct CachedManifoldT {
+    uint32_t frame = 0;
+    int count = 0;
+    CachedContactT<S> contacts[2];
+};
+
+// Accumulated impulses survive between steps so the solver starts from last step's answer
+// instead of zero. Entries not touched in the current frame are dropped by `evictStale`.
+template <typename S>
+struct ContactCacheT {
+    using CachedManifold = CachedManifoldT<S>;
+
+    using Entry = std::pair<const uint64_t, CachedManifold>;
+    std::unordered_map<uint64_t, CachedManifold, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                       TaggedAllocator<Entry, MemoryTag::Contacts>> entries;
+    uint32_t frame = 0;
+
+    static uint64_t key(uint32_t a, uint32_t b) {
+        if (a > b) std::swap(a, b);
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    void beginFrame() { ++frame; }
+
+    template <typename P>
+    void fetch(uint64_t pairKey, Manifold<P>& m) const {
+        auto it = entries.find(pairKey);
+        if (it == entries.end()) return;
+        const CachedManifold& cached = it->second;
+        for (int i = 0; i < m.count; ++i) {
+            for (int j = 0; j < cached.count; ++j) {
+                if (cached.contacts[j].feature != m.contacts[i].feature) continue;
+                m.contacts[i].normalImpulse = cached.contacts[j].normalImpulse;
+                m.contacts[i].tangentImpulse = cached.contacts[j].tangentImpulse;
+                break;
+            }
+        }
+    }
+
+    template <typename P>
+    void store(uint64_t pairKey, const Manifold<P>& m) {
+        CachedManifold& cached = entries[pairKey];
+        cached.frame = frame;
+        cached.count = m.count;
+        for (int i = 0; i < m.count; ++i) {
+            cached.contacts[i] = {m.contacts[i].feature, m.contacts[i].normalImpulse, m.contacts[i].tangentImpulse};
+        }
+    }
+
+    void evictStale() {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.frame != frame) it = entries.erase(it);
+            else ++it;
+        }
+    }
+
+    void clear() { entries.clear(); }
+};
+
+template <typename P>
+inline ScalarOf<P> inverseMass(const P& p) {
+    using S = ScalarOf<P>;
+    return p.fixed ? S(0) : materialOf(p).inverseMass;
+}
+
+// A shape's vertices treated as one rigid body while its contacts are solved: the velocity of the
+// centroid and the spin about it, plus the offset and turn the position pass has built up. Solving
+// against these instead of single vertices is what lets a stack come to rest.
+template <typename S>
+struct RigidBodyT {
+    S cx = S(0), cy = S(0);
+    S vx = S(0), vy = S(0), w = S(0);
+    S inverseMass = S(0), inverseInertia = S(0);
+    S dx = S(0), dy = S(0), angle = S(0);
+
+    // The rigid motion with the vertices' momentum and angular momentum. A body with a pinned or
+    // dragged vertex keeps its motion and takes no impulses.
+    template <typename Vertices>
+    void gather(const Vertices& verts) {
+        S mass = S(0), mx = S(0), my = S(0), px = S(0), py = S(0);
+        bool pinned = false;
+        for (const auto* v : verts) {
+            S m = materialOf(*v).mass;
+            pinned |= v->fixed;
+            mass += m;
+            mx += m * v->x; my += m * v->y;
+            px += m * v->vx; py += m * v->vy;
+        }
+        cx = mx / mass; cy = my / mass;
+        vx = px / mass; vy = py / mass;
+        S inertia = S(0), spin = S(0);
+        for (const auto* v : verts) {
+            S m = materialOf(*v).mass;
+            S rx = v->x - cx, ry = v->y - cy;
+            inertia += m * (rx * rx + ry * ry);
+            spin += m * (rx * v->vy - ry * v->vx);
+        }
+        w = inertia > S(0) ? spin / inertia : S(0);
+        inverseMass = pinned ? S(0) : S(1) / mass;
+        inverseInertia = pinned || inertia == S(0) ? S(0) : S(1) / inertia;
+        dx = dy = angle = S(0);
+    }
+
+    // Moves the vertices by the accumulated offset and turn, and sets them moving with the body.
+    template <typename Vertices>
+    void scatter(const Vertices& verts) const {
+        if (inverseMass == S(0)) return;
+        S c = S(1) - angle * angle / S(2), s = angle;
+        S length = scalarSqrt(c * c + s * s);
+        c /= length;
+        s /= length;
+        for (auto* v : verts) {
+            S rx = v->x - cx, ry = v->y - cy;
+            S qx = c * rx - s * ry, qy = s * rx + c * ry;
+            v->x = cx + dx + qx;
+            v->y = cy + dy + qy;
+            v->vx = vx - w * qy;
+            v->vy = vy + w * qx;
+        }
+    }
+
+    void velocityAt(S rx, S ry, S& ox, S& oy) const {
+        ox = vx - w * ry;
+        oy = vy + w * rx;
+    }
+
+    // Static bodies are left untouched, so manifolds on different threads may share one.
+    bool movable() const { return inverseMass != S(0) || inverseInertia != S(0); }
+
+    void applyImpulse(S rx, S ry, S ix, S iy) {
+        if (!movable()) return;
+        vx += ix * inverseMass;
+        vy += iy * inverseMass;
+        w += (rx * iy - ry * ix) * inverseInertia;
+    }
+
+    void applyCorrection(S rx, S ry, S ix, S iy) {
+        if (!movable()) return;
+        dx += ix * inverseMass;
+        dy += iy * inverseMass;
+        angle += (rx * iy - ry * ix) * inverseInertia;
+    }
+};
+
+// Velocity of the vertex relative to the edge point it touches.
+template <typename P, typename Body>
+inline void relativeVelocity(const Contact<P>& c, const Body& a, const Body& b, ScalarOf<P>& rvx, ScalarOf<P>& rvy) {
+    using S = ScalarOf<P>;
+    S ax, ay, bx, by;
+    a.velocityAt(c.vertexArmX, c.vertexArmY, ax, ay);
+    b.velocityAt(c.edgeArmX, c.edgeArmY, bx, by);
+    rvx = ax - bx;
+    rvy = ay - by;
+}
+
+template <typename P, typename Body>
+inline void applyContactImpulse(const Contact<P>& c, Body& a, Body& b, ScalarOf<P> ix, ScalarOf<P> iy) {
+    a.applyImpulse(c.vertexArmX, c.vertexArmY, ix, iy);
+    b.applyImpulse(c.edgeArmX, c.edgeArmY, -ix, -iy);
+}
+
+// Fills in each contact's lever arms and effective masses from the two bodies, as gathered this
+// step. Contacts still apart by a gap may close it within the step but no faster, so a corner
+// hovering inside the contact margin settles instead of being held up. Approach speeds below
+// `restitutionThreshold` are treated as resting contact so gravity does not make stacked bodies
+// bounce every step.
+template <typename P, typename Body>
+inline void prepareManifold(Manifold<P>& m, const Body* bodies, ScalarOf<P> inverseDt,
+                            ScalarOf<P> restitutionThreshold = ScalarOf<P>(10)) {
+    using S = ScalarOf<P>;
+    const Body& a = bodies[m.vertexBody];
+    const Body& b = bodies[m.edgeBody];
+    S nx = m.normalX, ny = m.normalY;
+    for (int i = 0; i < m.count; ++i) {
+        Contact<P>& c = m.contacts[i];
+        c.vertexArmX = c.vertex->x + (c.vertexEnd->x - c.vertex->x) * c.s - a.cx;
+        c.vertexArmY = c.vertex->y + (c.vertexEnd->y - c.vertex->y) * c.s - a.cy;
+        c.edgeArmX = c.edgeStart->x + (c.edgeEnd->x - c.edgeStart->x) * c.t - b.cx;
+        c.edgeArmY = c.edgeStart->y + (c.edgeEnd->y - c.edgeStart->y) * c.t - b.cy;
+        auto effectiveMass = [&](S dirX, S dirY) {
+            S armA = c.vertexArmX * dirY - c.vertexArmY * dirX;
+            S armB = c.edgeArmX * dirY - c.edgeArmY * dirX;
+            S k = a.inverseMass + b.inverseMass + a.inverseInertia * armA * armA + b.inverseInertia * armB * armB;
+            return k > S(0) ? S(1) / k : S(0);
+        };
+        c.normalMass = effectiveMass(nx, ny);
+        c.tangentMass = effectiveMass(-ny, nx);
+        S rvx, rvy;
+        relativeVelocity(c, a, b, rvx, rvy);
+        S vn = rvx * nx + rvy * ny;
+        S restitution = std::min({materialOf(*c.vertex).restitution, materialOf(*c.vertexEnd).restitution,
+                                  materialOf(*c.edgeStart).restitution, materialOf(*c.edgeEnd).restitution});
+        S speculative = c.depth < S(0) ? c.depth * inverseDt : S(0);
+        c.velocityBias = vn < -restitutionThreshold ? std::max(speculative, -restitution * vn) : speculative;
+    }
+}
+
+template <typename P, typename Body>
+inline void warmStartManifold(const Manifold<P>& m, Body* bodies) {
+    using S = ScalarOf<P>;
+    S tx = -m.normalY, ty = m.normalX;
+    for (int i = 0; i < m.count; ++i) {
+        const Contact<P>& c = m.contacts[i];
+        applyContactImpulse(c, bodies[m.vertexBody], bodies[m.edgeBody],
+                            c.normalImpulse * m.normalX + c.tangentImpulse * tx,
+                            c.normalImpulse * m.normalY + c.tangentImpulse * ty);
+    }
+}
+
+// The effective-mass matrix of a two-point manifold along its normal. Returns false when the two
+// contacts are too close together to tell apart, for the caller to solve them one at a time.
+template <typename P, typename Body>
+inline bool normalBlock(const Manifold<P>& m, const Body& a, const Body& b,
+                        ScalarOf<P>& k11, ScalarOf<P>& k12, ScalarOf<P>& k22) {
+    using S = ScalarOf<P>;
+    const Contact<P>& c1 = m.contacts[0];
+    const Contact<P>& c2 = m.contacts[1];
+    S nx = m.normalX, ny = m.normalY;
+    S a1 = c1.vertexArmX * ny - c1.vertexArmY * nx, b1 = c1.edgeArmX * ny - c1.edgeArmY * nx;
+    S a2 = c2.vertexArmX * ny - c2.vertexArmY * nx, b2 = c2.edgeArmX * ny - c2.edgeArmY * nx;
+    S linear = a.inverseMass + b.inverseMass;
+    k11 = linear + a.inverseInertia * a1 * a1 + b.inverseInertia * b1 * b1;
+    k22 = linear + a.inverseInertia * a2 * a2 + b.inverseInertia * b2 * b2;
+    k12 = linear + a.inverseInertia * a1 * a2 + b.inverseInertia * b1 * b2;
+    return k11 * k11 < S(1000) * (k11 * k22 - k12 * k12);
+}
+
+// Solves x >= 0, K x + free >= 0, with each x_i zero unless its row is exactly zero: both
+// contacts pushing, then each alone, then neither. Returns false if no case fits.
+template <typename S>
+inline bool solveComplementarity(S k11, S k12, S k22, S free1, S free2, S& x1, S& x2) {
+    S determinant = k11 * k22 - k12 * k12;
+    x1 = (k12 * free2 - k22 * free1) / determinant;
+    x2 = (k12 * free1 - k11 * free2) / determinant;
+    if (x1 >= S(0) && x2 >= S(0)) return true;
+    x1 = -free1 / k11;
+    x2 = S(0);
+    if (x1 >= S(0) && k12 * x1 + free2 >= S(0)) return true;
+    x1 = S(0);
+    x2 = -free2 / k22;
+    if (x2 >= S(0) && k12 * x2 + free1 >= S(0)) return true;
+    x1 = x2 = S(0);
+    return free1 >= S(0) && free2 >= S(0);
+}
+
+// One sequential-impulse pass. Accumulated impulses are clamped rather than each increment, which
+// is what makes carrying them over between steps safe.
+template <typename P, typename Body>
+inline void solveManifoldVelocity(Manifold<P>& m, Body* bodies) {
+    using S = ScalarOf<P>;
+    Body& a = bodies[m.vertexBody];
+    Body& b = bodies[m.edgeBody];
+    S nx = m.normalX, ny = m.normalY;
+    S tx = -ny, ty = nx;
+    for (int i = 0; i < m.count; ++i) {
+        Contact<P>& c = m.contacts[i];
+        if (c.tangentMass == S(0)) continue;
+        S rvx, rvy;
+        relativeVelocity(c, a, b, rvx, rvy);
+        S vt = rvx * tx + rvy * ty;
+        S friction = std::max({materialOf(*c.vertex).friction, materialOf(*c.vertexEnd).friction,
+                               materialOf(*c.edgeStart).friction, materialOf(*c.edgeEnd).friction});
+        S maxFriction = friction * c.normalImpulse;
+        S newTangent = std::max(-maxFriction, std::min(maxFriction, c.tangentImpulse - vt * c.tangentMass));
+        S dt = newTangent - c.tangentImpulse;
+        c.tangentImpulse = newTangent;
+        applyContactImpulse(c, a, b, dt * tx, dt * ty);
+    }
+    // The two normal impulses of a two-point manifold are found together, so a box resting flat on
+    // another gets the same push at both corners instead of rocking between them.
+    S k11, k12, k22;
+    if (m.count == 2 && normalBlock(m, a, b, k11, k12, k22)) {
+        Contact<P>& c1 = m.contacts[0];
+        Contact<P>& c2 = m.contacts[1];
+        S rvx, rvy;
+        relativeVelocity(c1, a, b, rvx, rvy);
+        S vn1 = rvx * nx + rvy * ny;
+        relativeVelocity(c2, a, b, rvx, rvy);
+        S vn2 = rvx * nx + rvy * ny;
+        S old1 = c1.normalImpulse, old2 = c2.normalImpulse;
+        // What each contact's approach would be with no normal impulse, less the bias it wants.
+        S free1 = vn1 - c1.velocityBias - (k11 * old1 + k12 * old2);
+        S free2 = vn2 - c2.velocityBias - (k12 * old1 + k22 * old2);
+        S x1, x2;
+        if (!solveComplementarity(k11, k12, k22, free1, free2, x1, x2)) return;
+        c1.normalImpulse = x1;
+        c2.normalImpulse = x2;
+        applyContactImpulse(c1, a, b, (x1 - old1) * nx, (x1 - old1) * ny);
+        applyContactImpulse(c2, a, b, (x2 - old2) * nx, (x2 - old2) * ny);
+        return;
+    }
+    for (int i = 0; i < m.count; ++i) {
+        Contact<P>& c = m.contacts[i];
+        if (c.normalMass == S(0)) continue;
+        S rvx, rvy;
+        relativeVelocity(c, a, b, rvx, rvy);
+        S vn = rvx * nx + rvy * ny;
+        S newNormal = std::max(S(0), c.normalImpulse + (c.velocityBias - vn) * c.normalMass);
+        S dn = newNormal - c.normalImpulse;
+        c.normalImpulse = newNormal;
+        applyContactImpulse(c, a, b, dn * nx, dn * ny);
+    }
+}
+
+// How far contact `c` still overlaps, after the offsets and turns applied so far this step.
+template <typename P, typename Body>
+inline ScalarOf<P> currentDepth(const Contact<P>& c, const Manifold<P>& m, const Body& a, const Body& b) {
+    using S = ScalarOf<P>;
+    S moveX = (a.dx - a.angle * c.vertexArmY) - (b.dx - b.angle * c.edgeArmY);
+    S moveY = (a.dy + a.angle * c.vertexArmX) - (b.dy + b.angle * c.edgeArmX);
+    return c.depth - (moveX * m.normalX + moveY * m.normalY);
+}
+
+// One pass pushing overlapping bodies apart along the normal, solved like the velocities: both
+// points of a two-point manifold together. Each push is capped at `maxCorrection` so deep overlaps
+// are resolved over several steps instead of launching the bodies.
+template <typename P, typename Body>
+inline void solveManifoldPosition(const Manifold<P>& m, Body* bodies, ScalarOf<P> slop = ScalarOf<P>(0.1),
+                                  ScalarOf<P> baumgarte = ScalarOf<P>(0.8), ScalarOf<P> maxCorrection = ScalarOf<P>(5)) {
+    using S = ScalarOf<P>;
+    Body& a = bodies[m.vertexBody];
+    Body& b = bodies[m.edgeBody];
+    S nx = m.normalX, ny = m.normalY;
+    auto push = [&](const Contact<P>& c, S impulse) {
+        a.applyCorrection(c.vertexArmX, c.vertexArmY, nx * impulse, ny * impulse);
+        b.applyCorrection(c.edgeArmX, c.edgeArmY, -nx * impulse, -ny * impulse);
+    };
+    auto wanted = [&](const Contact<P>& c) {
+        return std::min((currentDepth(c, m, a, b) - slop) * baumgarte, maxCorrection);
+    };
+    S k11, k12, k22;
+    if (m.count == 2 && normalBlock(m, a, b, k11, k12, k22)) {
+        S x1, x2;
+        if (!solveComplementarity(k11, k12, k22, -wanted(m.contacts[0]), -wanted(m.contacts[1]), x1, x2)) return;
+        push(m.contacts[0], x1);
+        push(m.contacts[1], x2);
+        return;
+    }
+    for (int i = 0; i < m.count; ++i) {
+        const Contact<P>& c = m.contacts[i];
+        if (c.normalMass == S(0)) continue;
+        S correction = wanted(c);
+        if (correction > S(0)) push(c, correction * c.normalMass);
+    }
+}
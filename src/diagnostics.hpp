@@ -0,0 +1,34 @@
+#pragma once
+
+#include <algorithm>
+#include "scalar.hpp"
+
+// Energy and momentum of the world, gathered by the integrator as it moves each point. Potential
+// energy is measured against the floor under the uniform gravity; the constraint violation is the
+// largest relative error of a square side or rope link once the integrator has enforced them.
+template <typename S>
+struct DiagnosticsT {
+    S kineticEnergy = S(0);
+    S potentialEnergy = S(0);
+    S momentumX = S(0), momentumY = S(0);
+    S maxConstraintViolation = S(0);
+
+    S totalEnergy() const { return kineticEnergy + potentialEnergy; }
+
+    void addPoint(S mass, S vx, S vy, S gravity, S height) {
+        kineticEnergy += S(0.5) * mass * (vx * vx + vy * vy);
+        potentialEnergy += mass * gravity * height;
+        momentumX += mass * vx;
+        momentumY += mass * vy;
+    }
+
+    void addViolation(S violation) { maxConstraintViolation = std::max(maxConstraintViolation, violation); }
+
+    void merge(const DiagnosticsT& other) {
+        kineticEnergy += other.kineticEnergy;
+        potentialEnergy += other.potentialEnergy;
+        momentumX += other.momentumX;
+        momentumY += other.momentumY;
+        addViolation(other.maxConstraintViolation);
+    }
+};
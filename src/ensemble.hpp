@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "structures.hpp"
+#include "threading.hpp"
+
+// Material and gravity settings one member of a sweep overrides on its world.
+template <typename S>
+struct SweepParametersT {
+    S restitution = S(0.8);
+    S friction = S(0);
+    S damping = S(0.99);
+    S gravity = S(98);
+};
+
+template <typename S>
+struct EnsembleSummaryT {
+    size_t bodies = 0;
+    S meanY = S(0);
+    S maxSpeed = S(0);
+    DiagnosticsT<S> diagnostics;    // from the world's last step
+    double stepMs = 0.0;    // total time spent stepping this world
+};
+
+template <typename S>
+struct EnsembleMemberT {
+    SweepParametersT<S> parameters;
+    ParticleSystemT<S> world;
+    EnsembleSummaryT<S> summary;
+};
+
+// Independent worlds stepped side by side. Each world runs single-threaded and shares nothing
+// with the others, so members are simply split across the pool and a sweep costs about the sum
+// of its worlds' step times divided by the thread count.
+template <typename S>
+struct EnsembleT {
+    using Member = EnsembleMemberT<S>;
+
+    std::vector<Member> members;
+
+    // One world per parameter set; `build` fills each before the sweep values are applied.
+    template <typename Build>
+    void create(const std::vector<SweepParametersT<S>>& sweep, Build&& build) {
+        members.clear();
+        members.resize(sweep.size());
+        for (size_t i = 0; i < sweep.size(); ++i) {
+            members[i].parameters = sweep[i];
+            build(members[i].world);
+            members[i].world.diagnosticsEnabled = true;
+            apply(members[i].world, sweep[i]);
+        }
+    }
+
+    static void apply(ParticleSystemT<S>& world, const SweepParametersT<S>& parameters) {
+        // Points keep their own mass; each material in the world maps to one with the sweep's surface.
+        std::map<uint16_t, uint16_t> swept;
+        auto set = [&](PointT<S>& p) {
+            auto found = swept.find(p.material);
+            if (found == swept.end()) {
+                MaterialT<S> material = materialOf(p);
+                material.restitution = parameters.restitution;
+                material.friction = parameters.friction;
+                material.damping = parameters.damping;
+                found = swept.emplace(p.material, addMaterial(material)).first;
+            }
+            p.material = found->second;
+        };
+        forEachPoint(world, set);
+        world.recountFlags();
+        for (auto& field : world.forceFields) {
+            if (field.type == ForceType::Gravity) field.strength = parameters.gravity;
+        }
+    }
+
+    template <typename Fn>
+    static void forEachPoint(ParticleSystemT<S>& world, Fn&& fn) {
+        for (auto& p : world.points) fn(p);
+        forEachShapeVertex(world, fn);
+    }
+
+    // The vertices of shapes and chains, whose vx, vy always hold velocities.
+    template <typename Fn>
+    static void forEachShapeVertex(ParticleSystemT<S>& world, Fn&& fn) {
+        for (auto& t : world.triangles) for (auto* p : t.vertices()) fn(*p);
+        for (auto& s : world.squares) for (auto* p : s.vertices()) fn(*p);
+        for (auto& c : world.chains) for (auto& p : c.points) fn(p);
+    }
+
+    void run(int steps, S dt, ThreadPool* pool) {
+        parallelFor(pool, members.size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                Member& member = members[i];
+                auto start = std::chrono::steady_clock::now();
+                for (int step = 0; step < steps; ++step) member.world.update(dt);
+                member.summary.stepMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                summarize(member);
+            }
+        }, 1);
+    }
+
+    static void summarize(Member& member) {
+        auto& summary = member.summary;
+        summary.bodies = member.world.points.size() + member.world.triangles.size() +
+                         member.world.squares.size() + member.world.chains.size();
+        S sumY = S(0), maxSpeedSq = S(0);
+        int count = 0;
+        auto visit = [&](const PointT<S>& p, S vx, S vy) {
+            sumY += p.y;
+            maxSpeedSq = std::max(maxSpeedSq, vx * vx + vy * vy);
+            ++count;
+        };
+        for (const auto& p : member.world.points) {
+            S vx, vy;
+            member.world.velocityOf(p, vx, vy);
+            visit(p, vx, vy);
+        }
+        forEachShapeVertex(member.world, [&](const PointT<S>& p) { visit(p, p.vx, p.vy); });
+        summary.meanY = count ? sumY / S(count) : S(0);
+        summary.diagnostics = member.world.diagnostics;
+        summary.maxSpeed = scalarSqrt(maxSpeedSq);
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "scalar.hpp"
+
+// Q32.32 fixed-point scalar for lockstep simulation. Every operation is integer arithmetic with a
+// defined rounding (products and quotients truncate, literals round to nearest), so a scene stepped
+// with `Fixed` gives bit-identical results on any compiler with 128-bit integers, which GCC and
+// Clang provide on x86-64 and ARM64. The range is about +/-2e9 with a resolution of 2.3e-10: enough
+// for the integrator, shape constraints, contacts and chains, but not for the SPH kernel constants,
+// so the fluid stays a float/double feature.
+struct Fixed {
+    __extension__ using Wide = __int128;
+    static constexpr int fractionBits = 32;
+    static constexpr int64_t one = int64_t(1) << fractionBits;
+
+    int64_t raw = 0;
+
+    constexpr Fixed() = default;
+    constexpr Fixed(int v) : raw(static_cast<int64_t>(v) * one) {}
+    explicit Fixed(double v) : raw(static_cast<int64_t>(std::llround(v * 4294967296.0))) {}
+
+    static constexpr Fixed fromRaw(int64_t raw) { Fixed f; f.raw = raw; return f; }
+
+    // Truncates toward zero, like the conversion from float.
+    explicit constexpr operator int() const { return static_cast<int>(raw / one); }
+    explicit constexpr operator double() const { return static_cast<double>(raw) / 4294967296.0; }
+    explicit constexpr operator float() const { return static_cast<float>(static_cast<double>(*this)); }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return fromRaw(a.raw + b.raw); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return fromRaw(a.raw - b.raw); }
+    friend constexpr Fixed operator-(Fixed a) { return fromRaw(-a.raw); }
+    friend constexpr Fixed operator*(Fixed a, Fixed b) {
+        return fromRaw(static_cast<int64_t>((static_cast<Wide>(a.raw) * b.raw) >> fractionBits));
+    }
+    friend constexpr Fixed operator/(Fixed a, Fixed b) {
+        return fromRaw(static_cast<int64_t>(static_cast<Wide>(a.raw) * one / b.raw));
+    }
+
+    Fixed& operator+=(Fixed b) { return *this = *this + b; }
+    Fixed& operator-=(Fixed b) { return *this = *this - b; }
+    Fixed& operator*=(Fixed b) { return *this = *this * b; }
+    Fixed& operator/=(Fixed b) { return *this = *this / b; }
+
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+};
+
+// Seeds for integerSqrt: entry t is ceil(16 * sqrt(t + 1)), an upper bound for 16 * sqrt(x) over
+// every x whose leading bits are t.
+struct SqrtSeedTable {
+    uint16_t entry[256];
+
+    constexpr SqrtSeedTable() : entry() {
+        for (uint32_t t = 0; t < 256; ++t) {
+            uint32_t k = 0;
+            while (k * k < 256 * (t + 1)) ++k;
+            entry[t] = static_cast<uint16_t>(k);
+        }
+    }
+};
+
+// Floor of the square root of a 128-bit integer. The seed from the leading seven or eight bits is
+// less than 1% above the root; integer Newton steps from above never drop below the floor and
+// square the relative error, so three of them bring a 48-bit root to within one of the answer,
+// which a multiply then settles.
+inline uint64_t integerSqrt(unsigned __int128 n) {
+    static constexpr SqrtSeedTable seeds;
+    if (n < 2) return static_cast<uint64_t>(n);
+    uint64_t high = static_cast<uint64_t>(n >> 64);
+    int top = high ? 127 - __builtin_clzll(high) : 63 - __builtin_clzll(static_cast<uint64_t>(n));
+    int shift = top < 6 ? 0 : (top - 6) & ~1;
+    uint32_t lead = static_cast<uint32_t>(n >> shift);
+    uint64_t r = static_cast<uint64_t>(((static_cast<unsigned __int128>(seeds.entry[lead]) << (shift / 2)) + 15) >> 4);
+    for (int i = 0; i < 3; ++i) r = static_cast<uint64_t>((r + n / r) >> 1);
+    while (static_cast<unsigned __int128>(r) * r > n) --r;
+    return r;
+}
+
+// sqrt(raw / 2^32) * 2^32 = sqrt(raw * 2^32). Negative inputs give zero.
+template <>
+inline Fixed scalarSqrt<Fixed>(Fixed v) {
+    if (v.raw <= 0) return Fixed();
+    return Fixed::fromRaw(static_cast<int64_t>(integerSqrt(static_cast<unsigned __int128>(v.raw) << Fixed::fractionBits)));
+}
+
+template <>
+inline Fixed scalarAbs<Fixed>(Fixed v) { return v.raw < 0 ? -v : v; }
+
+namespace std {
+template <>
+struct numeric_limits<Fixed> : numeric_limits<int64_t> {
+    static constexpr Fixed lowest() noexcept { return Fixed::fromRaw(numeric_limits<int64_t>::min()); }
+    static constexpr Fixed min() noexcept { return Fixed::fromRaw(1); }
+    static constexpr Fixed max() noexcept { return Fixed::fromRaw(numeric_limits<int64_t>::max()); }
+};
+}
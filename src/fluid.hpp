@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "memory.hpp"
+#include "scalar.hpp"
+#include "threading.hpp"
+
+// Smoothed-particle hydrodynamics over the free points. Particles are kept in cell order as
+// structure-of-arrays copies so the kernels stream through memory; neighbour lists are built with
+// a `skin` and reused until some particle has drifted more than half of it, which lets most steps
+// skip the grid search entirely. Density and force passes only gather, so they split across
+// threads without synchronisation.
+template <typename S>
+struct FluidT {
+    bool enabled = false;
+    S smoothingRadius = S(16);
+    S skin = S(4);
+    S spacing = S(8);           // rest spacing; the rest density is derived from it
+    S stiffness = S(40000);
+    S viscosity = S(10);
+    S particleMass = S(1);
+
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::Fluid>;
+
+    Vector<uint32_t> order;     // order[k] is the point stored in slot k
+    Vector<S> xs, ys, vxs, vys, volume, pressure;
+    Vector<S> buildX, buildY;
+    Vector<uint32_t> neighbourStart, neighbours;
+    Vector<Vector<uint32_t>> chunkNeighbours;
+    Vector<uint32_t> cellStart;
+    Vector<S> chunkDrift;
+    S originX = S(0), originY = S(0), cellSize = S(1);
+    int cols = 0, rows = 0;
+    S maxRadius = S(0);
+    bool valid = false;
+    size_t rebuilds = 0;
+
+    void invalidate() { valid = false; }
+
+    int cellX(S x) const { return std::clamp(static_cast<int>((x - originX) / cellSize), 0, cols - 1); }
+    int cellY(S y) const { return std::clamp(static_cast<int>((y - originY) / cellSize), 0, rows - 1); }
+
+    // 2D poly6, spiky gradient and viscosity Laplacian kernels with their constants folded once.
+    struct Kernels {
+        S h, hSq, poly6Scale, spikyScale, viscosityScale;
+
+        explicit Kernels(S radius) : h(radius), hSq(radius * radius) {
+            S pi = S(3.14159265358979);
+            S h5 = hSq * hSq * h;
+            poly6Scale = S(4) / (pi * hSq * hSq * hSq * hSq);
+            spikyScale = S(-30) / (pi * h5);
+            viscosityScale = S(40) / (pi * h5);
+        }
+        S poly6(S rSq) const { S d = hSq - rSq; return poly6Scale * d * d * d; }
+        S spikyGradient(S r) const { S d = h - r; return spikyScale * d * d; }
+        S viscosityLaplacian(S r) const { return viscosityScale * (h - r); }
+    };
+
+    S restDensity() const {
+        Kernels kernels(smoothingRadius);
+        int reach = static_cast<int>(smoothingRadius / spacing) + 1;
+        S sum = S(0);
+        for (int i = -reach; i <= reach; ++i) {
+            for (int j = -reach; j <= reach; ++j) {
+                S rSq = (S(i) * S(i) + S(j) * S(j)) * spacing * spacing;
+                if (rSq < kernels.hSq) sum += particleMass * kernels.poly6(rSq);
+            }
+        }
+        return sum;
+    }
+
+    // With a nonzero `inverseDt` the points hold their previous positions in vx, vy (Verlet), and
+    // the velocity is the displacement since then over the step.
+    template <typename PointVector>
+    void gather(const PointVector& points, ThreadPool* pool, S inverseDt = S(0)) {
+        parallelFor(pool, order.size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                const auto& p = points[order[k]];
+                xs[k] = p.x; ys[k] = p.y;
+                if (inverseDt == S(0)) { vxs[k] = p.vx; vys[k] = p.vy; }
+                else { vxs[k] = (p.x - p.vx) * inverseDt; vys[k] = (p.y - p.vy) * inverseDt; }
+            }
+        });
+    }
+
+    // Largest squared displacement since the neighbour lists were built.
+    template <typename PointVector>
+    S drift(const PointVector& points, ThreadPool* pool) {
+        chunkDrift.assign(pool ? pool->size() : 1, S(0));
+        parallelFor(pool, order.size(), [&](size_t begin, size_t end, unsigned chunk) {
+            S worst = S(0);
+            for (size_t k = begin; k < end; ++k) {
+                const auto& p = points[order[k]];
+                S dx = p.x - buildX[k], dy = p.y - buildY[k];
+                worst = std::max(worst, dx * dx + dy * dy);
+            }
+            chunkDrift[chunk] = worst;
+        });
+        return *std::max_element(chunkDrift.begin(), chunkDrift.end());
+    }
+
+    template <typename PointVector>
+    void refresh(const PointVector& points, ThreadPool* pool) {
+        S half = skin / S(2);
+        if (!valid || order.size() != points.size() || drift(points, pool) > half * half) rebuild(points, pool);
+    }
+
+    template <typename PointVector>
+    void rebuild(const PointVector& points, ThreadPool* pool) {
+        size_t n = points.size();
+        valid = true;
+        ++rebuilds;
+        order.resize(n);
+        xs.resize(n); ys.resize(n); vxs.resize(n); vys.resize(n);
+        volume.resize(n); pressure.resize(n);
+        neighbourStart.assign(n + 1, 0);
+        neighbours.clear();
+        cols = rows = 0;
+        if (n == 0) return;
+
+        S minX = points[0].x, minY = points[0].y, maxX = minX, maxY = minY;
+        maxRadius = S(0);
+        for (const auto& p : points) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+            maxRadius = std::max(maxRadius, p.radius);
+        }
+        // Cells never shrink below the search radius; they only grow when the particles are spread
+        // so thin that the grid would dwarf the particle count.
+        cellSize = smoothingRadius + skin;
+        while ((maxX - minX) / cellSize * ((maxY - minY) / cellSize) > S(4 * static_cast<int>(n) + 1024)) cellSize *= S(2);
+        originX = minX;
+        originY = minY;
+        cols = static_cast<int>((maxX - minX) / cellSize) + 1;
+        rows = static_cast<int>((maxY - minY) / cellSize) + 1;
+
+        Vector<uint32_t> cellOf(n);
+        cellStart.assign(static_cast<size_t>(cols) * rows + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            cellOf[i] = static_cast<uint32_t>(cellY(points[i].y) * cols + cellX(points[i].x));
+            ++cellStart[cellOf[i] + 1];
+        }
+        for (size_t c = 0; c + 1 < cellStart.size(); ++c) cellStart[c + 1] += cellStart[c];
+        Vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < n; ++i) order[cursor[cellOf[i]]++] = static_cast<uint32_t>(i);
+
+        gather(points, pool);
+        buildX = xs;
+        buildY = ys;
+
+        // Cells are stored row-major in slot order, so the 3x3 block around a particle is three
+        // contiguous slot ranges. Each chunk collects its lists into its own buffer; the buffers are
+        // concatenated in chunk order afterwards.
+        S reach = smoothingRadius + skin;
+        S reachSq = reach * reach;
+        chunkNeighbours.resize(pool ? pool->size() : 1);
+        for (auto& part : chunkNeighbours) part.clear();
+        parallelFor(pool, n, [&](size_t begin, size_t end, unsigned chunk) {
+            auto& out = chunkNeighbours[chunk];
+            for (size_t k = begin; k < end; ++k) {
+                S x = xs[k], y = ys[k];
+                int cx = cellX(x), cy = cellY(y);
+                int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, cols - 1);
+                size_t before = out.size();
+                for (int row = std::max(cy - 1, 0); row <= std::min(cy + 1, rows - 1); ++row) {
+                    uint32_t first = cellStart[row * cols + x0], last = cellStart[row * cols + x1 + 1];
+                    for (uint32_t j = first; j < last; ++j) {
+                        S dx = xs[j] - x, dy = ys[j] - y;
+                        if (dx * dx + dy * dy < reachSq && j != k) out.push_back(j);
+                    }
+                }
+                neighbourStart[k + 1] = static_cast<uint32_t>(out.size() - before);
+            }
+        });
+        for (size_t k = 0; k < n; ++k) neighbourStart[k + 1] += neighbourStart[k];
+        neighbours.resize(neighbourStart[n]);
+        size_t at = 0;
+        for (auto& part : chunkNeighbours) {
+            std::copy(part.begin(), part.end(), neighbours.begin() + at);
+            at += part.size();
+        }
+    }
+
+    // Adds the pressure and viscosity accelerations of every point to ax/ay (indexed like points).
+    // `inverseDt` is as for `gather`.
+    template <typename PointVector, typename AccelerationVector>
+    void computeForces(const PointVector& points, ThreadPool* pool, AccelerationVector& ax, AccelerationVector& ay,
+                       S inverseDt = S(0)) {
+        refresh(points, pool);
+        gather(points, pool, inverseDt);
+        size_t n = order.size();
+        Kernels kernels(smoothingRadius);
+        S rest = restDensity();
+        S selfDensity = particleMass * kernels.poly6(S(0));
+
+        // Each particle's volume m / rho is the form both force terms use.
+        parallelFor(pool, n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                S sum = S(0);
+                for (uint32_t e = neighbourStart[k]; e < neighbourStart[k + 1]; ++e) {
+                    uint32_t j = neighbours[e];
+                    S dx = xs[j] - xs[k], dy = ys[j] - ys[k];
+                    S rSq = dx * dx + dy * dy;
+                    if (rSq < kernels.hSq) sum += kernels.poly6(rSq);
+                }
+                S rho = selfDensity + particleMass * sum;
+                volume[k] = particleMass / rho;
+                pressure[k] = stiffness * std::max(rho - rest, S(0));
+            }
+        });
+
+        parallelFor(pool, n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                S fx = S(0), fy = S(0);
+                S xk = xs[k], yk = ys[k], vxk = vxs[k], vyk = vys[k], pk = pressure[k];
+                for (uint32_t e = neighbourStart[k]; e < neighbourStart[k + 1]; ++e) {
+                    uint32_t j = neighbours[e];
+                    S dx = xk - xs[j], dy = yk - ys[j];
+                    S rSq = dx * dx + dy * dy;
+                    if (rSq >= kernels.hSq || rSq == S(0)) continue;
+                    S r = scalarSqrt(rSq);
+                    S push = -(pk + pressure[j]) * volume[j] * kernels.spikyGradient(r) / r;
+                    S visc = viscosity * volume[j] * kernels.viscosityLaplacian(r);
+                    fx += S(0.5) * push * dx + visc * (vxs[j] - vxk);
+                    fy += S(0.5) * push * dy + visc * (vys[j] - vyk);
+                }
+                S scale = volume[k] / particleMass;
+                ax[order[k]] += fx * scale;
+                ay[order[k]] += fy * scale;
+            }
+        });
+    }
+
+    // Calls fn(pointIndex) for every particle that may overlap the box. Only valid after `refresh`.
+    template <typename Fn>
+    void forEachNear(S minX, S minY, S maxX, S maxY, Fn&& fn) const {
+        if (cols == 0) return;
+        S pad = skin / S(2) + maxRadius;
+        int x0 = cellX(minX - pad), x1 = cellX(maxX + pad);
+        int y0 = cellY(minY - pad), y1 = cellY(maxY + pad);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                int c = y * cols + x;
+                for (uint32_t k = cellStart[c]; k < cellStart[c + 1]; ++k) fn(order[k]);
+            }
+        }
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "memory.hpp"
+#include "scalar.hpp"
+
+template <typename S>
+struct SegmentT {
+    S x1, y1, x2, y2;
+};
+
+// Static colliders never move, so their grid is built once (CSR layout) and only read afterwards.
+// Every segment is binned into all cells its bounds touch after inflating by `margin`, which lets a
+// body find every segment it can reach by looking at the single cell under its centre.
+template <typename S>
+struct StaticGeometryT {
+    using Segment = SegmentT<S>;
+
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::Geometry>;
+
+    Vector<Segment> segments;
+    S cellSize = S(64);
+    S margin = S(50);
+    S originX = S(0), originY = S(0);
+    int cols = 0, rows = 0;
+    Vector<int> cellStart;
+    Vector<int> cellItems;
+    bool built = false;
+
+    void addSegment(S x1, S y1, S x2, S y2) {
+        segments.push_back({x1, y1, x2, y2});
+        built = false;
+    }
+
+    void addWall(S minX, S minY, S maxX, S maxY) {
+        addSegment(minX, minY, maxX, minY);
+        addSegment(maxX, minY, maxX, maxY);
+        addSegment(maxX, maxY, minX, maxY);
+        addSegment(minX, maxY, minX, minY);
+    }
+
+    void addPolyline(const std::vector<std::pair<S, S>>& vertices, bool closed = false) {
+        if (vertices.size() < 2) return;
+        for (size_t i = 0; i + 1 < vertices.size(); ++i) {
+            addSegment(vertices[i].first, vertices[i].second, vertices[i + 1].first, vertices[i + 1].second);
+        }
+        if (closed) addSegment(vertices.back().first, vertices.back().second, vertices.front().first, vertices.front().second);
+    }
+
+    void clear() {
+        segments.clear();
+        cellStart.clear();
+        cellItems.clear();
+        cols = rows = 0;
+        built = false;
+    }
+
+    void build() {
+        built = true;
+        cellStart.clear();
+        cellItems.clear();
+        cols = rows = 0;
+        if (segments.empty()) return;
+
+        S minX = segments[0].x1, minY = segments[0].y1, maxX = minX, maxY = minY;
+        for (const auto& s : segments) {
+            minX = std::min({minX, s.x1, s.x2});
+            minY = std::min({minY, s.y1, s.y2});
+            maxX = std::max({maxX, s.x1, s.x2});
+            maxY = std::max({maxY, s.y1, s.y2});
+        }
+        originX = minX - margin;
+        originY = minY - margin;
+        cols = static_cast<int>((maxX + margin - originX) / cellSize) + 1;
+        rows = static_cast<int>((maxY + margin - originY) / cellSize) + 1;
+
+        auto forEachCell = [&](const Segment& s, auto&& fn) {
+            int cx0 = cellX(std::min(s.x1, s.x2) - margin), cx1 = cellX(std::max(s.x1, s.x2) + margin);
+            int cy0 = cellY(std::min(s.y1, s.y2) - margin), cy1 = cellY(std::max(s.y1, s.y2) + margin);
+            for (int cy = cy0; cy <= cy1; ++cy)
+                for (int cx = cx0; cx <= cx1; ++cx) fn(cy * cols + cx);
+        };
+
+        cellStart.assign(cols * rows + 1, 0);
+        for (const auto& s : segments) forEachCell(s, [&](int c) { ++cellStart[c + 1]; });
+        for (int c = 0; c < cols * rows; ++c) cellStart[c + 1] += cellStart[c];
+        cellItems.resize(cellStart.back());
+        Vector<int> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (int i = 0; i < static_cast<int>(segments.size()); ++i) {
+            forEachCell(segments[i], [&](int c) { cellItems[cursor[c]++] = i; });
+        }
+    }
+
+    int cellX(S x) const { return std::clamp(static_cast<int>((x - originX) / cellSize), 0, cols - 1); }
+    int cellY(S y) const { return std::clamp(static_cast<int>((y - originY) / cellSize), 0, rows - 1); }
+
+    template <typename Fn>
+    void forEachNear(S x, S y, Fn&& fn) const {
+        if (cols == 0) return;
+        if (x < originX || y < originY || x >= originX + S(cols) * cellSize || y >= originY + S(rows) * cellSize) return;
+        int c = cellY(y) * cols + cellX(x);
+        for (int i = cellStart[c]; i < cellStart[c + 1]; ++i) fn(segments[cellItems[i]]);
+    }
+};
+
+enum class BoundsPolicy { None, Cull, Recycle };
+
+// Bodies whose centre leaves the bounds are either removed or moved back to the spawn point at rest.
+template <typename S>
+struct WorldBoundsT {
+    S minX = S(-1000), minY = S(-1000);
+    S maxX = S(2280), maxY = S(1720);
+    S spawnX = S(640), spawnY = S(100);
+    BoundsPolicy policy = BoundsPolicy::None;
+
+    bool contains(S x, S y) const {
+        return x >= minX && x <= maxX && y >= minY && y <= maxY;
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+#include "memory.hpp"
+#include "threading.hpp"
+
+// A small dependency graph of jobs, rebuilt and run once per step. A job may only depend on jobs
+// added before it, so the graph is acyclic by construction. `run` hands each job to the pool as
+// soon as its dependencies are done, then records the longest chain of dependent jobs, which bounds
+// how fast the step can go however many threads there are.
+struct JobGraph {
+    using Clock = std::chrono::steady_clock;
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::Scheduler>;
+    static constexpr uint32_t none = UINT32_MAX;    // ignored in dependency lists
+
+    struct Job {
+        const char* name;
+        std::function<void()> fn;
+        Vector<uint32_t> dependencies;
+        double startMs = 0.0, endMs = 0.0;  // from the start of `run`
+    };
+
+    Vector<Job> jobs;
+    Vector<uint32_t> criticalPath;          // job indices, first to last
+    double criticalPathMs = 0.0;
+    double wallMs = 0.0;
+
+    Vector<uint32_t> waiting;
+    Vector<Vector<uint32_t>> dependents;
+
+    void clear() { jobs.clear(); }
+
+    uint32_t add(const char* name, std::function<void()> fn, std::initializer_list<uint32_t> dependencies = {}) {
+        Job job{name, std::move(fn), {}};
+        for (uint32_t d : dependencies) if (d != none) job.dependencies.push_back(d);
+        jobs.push_back(std::move(job));
+        return static_cast<uint32_t>(jobs.size() - 1);
+    }
+
+    // Runs every job once its dependencies have finished. Each job becomes a pool task as soon as
+    // it is ready, and the calling thread runs tasks until the graph is done; jobs may use the
+    // pool themselves. With no pool they run in order on the calling thread.
+    void run(ThreadPool* pool) {
+        size_t n = jobs.size();
+        waiting.assign(n, 0);
+        dependents.resize(n);
+        for (auto& d : dependents) d.clear();
+        for (uint32_t j = 0; j < n; ++j) {
+            waiting[j] = static_cast<uint32_t>(jobs[j].dependencies.size());
+            for (uint32_t d : jobs[j].dependencies) dependents[d].push_back(j);
+        }
+        auto start = Clock::now();
+        auto since = [&] { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+        auto execute = [&](uint32_t j) {
+            jobs[j].startMs = since();
+            jobs[j].fn();
+            jobs[j].endMs = since();
+        };
+        if (!pool) {
+            for (uint32_t j = 0; j < n; ++j) execute(j);
+        } else {
+            std::mutex mutex;
+            ThreadPool::Batch batch;
+            std::function<void(uint32_t)> launch = [&](uint32_t j) {
+                pool->submit(batch, [&, j] {
+                    execute(j);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (uint32_t d : dependents[j]) if (--waiting[d] == 0) launch(d);
+                });
+            };
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (uint32_t j = 0; j < n; ++j) if (waiting[j] == 0) launch(j);
+            }
+            pool->wait(batch);
+        }
+        wallMs = since();
+        findCriticalPath();
+    }
+
+    void findCriticalPath() {
+        Vector<double> finish(jobs.size(), 0.0);
+        Vector<uint32_t> parent(jobs.size(), none);
+        uint32_t last = none;
+        for (uint32_t j = 0; j < jobs.size(); ++j) {
+            for (uint32_t d : jobs[j].dependencies) {
+                if (finish[d] > finish[j]) { finish[j] = finish[d]; parent[j] = d; }
+            }
+            finish[j] += jobs[j].endMs - jobs[j].startMs;
+            if (last == none || finish[j] > finish[last]) last = j;
+        }
+        criticalPath.clear();
+        for (uint32_t j = last; j != none; j = parent[j]) criticalPath.insert(criticalPath.begin(), j);
+        criticalPathMs = last == none ? 0.0 : finish[last];
+    }
+
+    // "a 0.12 > b 0.40 > c 0.05" for the critical path, in milliseconds per job.
+    void describeCriticalPath(char* out, size_t size) const {
+        if (size == 0) return;
+        out[0] = '\0';
+        size_t used = 0;
+        for (size_t k = 0; k < criticalPath.size() && used < size; ++k) {
+            const Job& job = jobs[criticalPath[k]];
+            int written = std::snprintf(out + used, size - used, "%s%s %.2f", k ? " > " : "", job.name, job.endMs - job.startMs);
+            if (written < 0) break;
+            used += static_cast<size_t>(written);
+        }
+    }
+};
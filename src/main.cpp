@@ -1,9 +1,13 @@
-#include "structures.hpp"
+#include "simulation.hpp"
+#include "camera.hpp"
 #include "../dependencies/imgui/backends/imgui.h"
 #include "../dependencies/imgui/backends/imgui_impl_glfw.h"
 #include "../dependencies/glad/include/glad/glad.h"
 #include "../dependencies/imgui/backends/imgui_impl_opengl3.h"
+#include <cfloat>
+#include <cmath>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -16,8 +20,6 @@ void create_particle(
     float radius,
     float vx,
     float vy,
-    float ax,
-    float ay,
     float mass = 1.0f,
     float restitution = 0.8f,
     float friction = 0,
@@ -26,7 +28,9 @@ void create_particle(
 );
 
 const float DELTATIME = 0.016f;
-ParticleSystem particleSystem;
+ThreadPool threadPool;
+Simulation simulation;
+Camera2D camera;
 
 int main() {
     if (!glfwInit()) return -1;
@@ -49,6 +53,22 @@ int main() {
 
     float bgColor[4] = {0.1f, 0.1f, 0.1f, 1.0f};
 
+    // The world is set up before the simulation thread starts; afterwards it is only changed
+    // through commands pushed to the simulation.
+    ParticleSystem& world = simulation.world;
+    world.staticGeometry.addWall(0.0f, 0.0f, 1280.0f, 720.0f);
+    world.bounds.policy = BoundsPolicy::Cull;
+    world.threadPool = &threadPool;
+
+    size_t gravityField = world.addForceField(ForceFieldT<Real>::gravity(9.8f));
+    size_t windField = world.addForceField(ForceFieldT<Real>::wind(0.0f));
+    size_t attractorField = world.addForceField(ForceFieldT<Real>::attractor(0.0f, 0.0f, 0.0f, 400.0f));
+    size_t dragField = world.addForceField(ForceFieldT<Real>::drag(0.0f));
+    const float fluidSpacing = static_cast<float>(world.fluid.spacing);
+
+    simulation.dt = DELTATIME;
+    simulation.start();
+
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
@@ -56,6 +76,59 @@ int main() {
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
+
+        const RenderSnapshot& frame = simulation.latest();
+
+        // Wheel zooms about the cursor and a middle-button drag pans, unless the mouse is over a
+        // window. Right-clicking a particle or square follows it; right-clicking empty space stops.
+        camera.width = io.DisplaySize.x;
+        camera.height = io.DisplaySize.y;
+        if (!io.WantCaptureMouse) {
+            if (io.MouseWheel != 0.0f) camera.zoomAt(io.MousePos.x, io.MousePos.y, std::pow(1.1f, io.MouseWheel));
+            if (ImGui::IsMouseDragging(ImGuiMouseButton_Middle)) camera.pan(io.MouseDelta.x, io.MouseDelta.y);
+        }
+        ImVec2 screenMouse = ImGui::GetMousePos();
+        ImVec2 mousePos(camera.toWorldX(screenMouse.x), camera.toWorldY(screenMouse.y));
+
+        static BodyHandle followHandle = 0;
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Right) && !io.WantCaptureMouse) {
+            followHandle = 0;
+            for (size_t i = 0; i < frame.pointIds.size() && !followHandle; ++i) {
+                float dx = mousePos.x - frame.points[3 * i], dy = mousePos.y - frame.points[3 * i + 1];
+                if (std::sqrt(dx * dx + dy * dy) < frame.points[3 * i + 2] + 5.0f) followHandle = frame.pointIds[i];
+            }
+            for (size_t i = 0; i < frame.squareIds.size() && !followHandle; ++i) {
+                const float* q = &frame.squares[12 * i];
+                float minX = std::min({q[0], q[3], q[6], q[9]}), maxX = std::max({q[0], q[3], q[6], q[9]});
+                float minY = std::min({q[1], q[4], q[7], q[10]}), maxY = std::max({q[1], q[4], q[7], q[10]});
+                if (mousePos.x >= minX && mousePos.x <= maxX && mousePos.y >= minY && mousePos.y <= maxY) followHandle = frame.squareIds[i];
+            }
+        }
+        if (followHandle) {
+            bool found = false;
+            for (size_t i = 0; i < frame.pointIds.size() && !found; ++i) {
+                if (frame.pointIds[i] != followHandle) continue;
+                camera.follow(frame.points[3 * i], frame.points[3 * i + 1], 0.99f, io.DeltaTime);
+                found = true;
+            }
+            for (size_t i = 0; i < frame.squareIds.size() && !found; ++i) {
+                if (frame.squareIds[i] != followHandle) continue;
+                const float* q = &frame.squares[12 * i];
+                camera.follow((q[0] + q[3] + q[6] + q[9]) / 4.0f, (q[1] + q[4] + q[7] + q[10]) / 4.0f, 0.99f, io.DeltaTime);
+                found = true;
+            }
+            if (!found) followHandle = 0;
+        }
+        // Level of detail, in screen pixels of radius: circles below `spriteBelow` become square
+        // sprites, and particles below `splatBelow` are summed into a density grid of 2 px cells.
+        static bool levelOfDetail = true;
+        static float spriteBelow = 2.0f, splatBelow = 0.5f;
+        SetView view{camera.visibleMinX(), camera.visibleMinY(), camera.visibleMaxX(), camera.visibleMaxY()};
+        if (levelOfDetail) {
+            view.splatRadius = splatBelow / camera.zoom;
+            view.splatCell = 2.0f / camera.zoom;
+        }
+        simulation.push(view);
     
         // Background color controls
         ImGui::SetNextWindowPos(ImVec2(50, 50), ImGuiCond_FirstUseEver);
@@ -67,7 +140,6 @@ int main() {
         static float x = 200.0f, y = 200.0f;
         static float radius = 10.0f;
         static float vx = 0.0f, vy = 0.0f;
-        static float ax = 0.0f, ay = -9.8f;
 
         ImGui::Begin("Particle Controls");
         ImGui::SliderFloat("X Position", &x, 0.0f, 1280.0f);
@@ -75,44 +147,31 @@ int main() {
         ImGui::SliderFloat("Radius", &radius, 1.0f, 50.0f);
         ImGui::SliderFloat("X Velocity", &vx, -100.0f, 100.0f);
         ImGui::SliderFloat("Y Velocity", &vy, -100.0f, 100.0f);
-        ImGui::SliderFloat("X Acceleration", &ax, -10.0f, 10.0f);
-        ImGui::SliderFloat("Y Acceleration", &ay, -10.0f, 10.0f);
 
         static bool gravityEnabled = true;
-        ImGui::Checkbox("Enable Gravity", &particleSystem.gravityEnabled);
+        ImGui::Checkbox("Enable Gravity", &gravityEnabled);
 
-        if (gravityEnabled) {
-            for (auto& p : particleSystem.points) {
-                p.ay = -9.8f;
-            }
-            for (auto& square : particleSystem.squares) {
-                for (auto* point : {&square.point1, &square.point2, &square.point3, &square.point4}) {
-                    point->ay = -9.8f;
-                }
-            }
-        } else {
-            for (auto& p : particleSystem.points) {
-                p.ay = 0.0f;
-            }
-            for (auto& square : particleSystem.squares) {
-                for (auto* point : {&square.point1, &square.point2, &square.point3, &square.point4}) {
-                    point->ay = 0.0f;
-                }
-            }
+        if (ImGui::Button("Create Particle")) {
+            create_particle(x, y, radius, vx, vy);
         }
 
-        if (ImGui::Button("Create Particle")) {
-            create_particle(x, y, radius, vx, vy, ax, ay);
+        static bool fluidEnabled = false;
+        if (ImGui::Button("Pour Fluid")) {
+            MaterialT<Real> water;
+            water.restitution = 0.1f;
+            water.damping = 1.0f;
+            Point droplet = {x, y, fluidSpacing / 2.0f, vx, vy};
+            droplet.material = addMaterial(water);
+            simulation.push(SpawnParticleGrid{droplet, 40, 1000, fluidSpacing});
+            fluidEnabled = true;
         }
 
         if (ImGui::Button("Delete Selected Particle")) {
-            for (auto it = particleSystem.points.begin(); it != particleSystem.points.end();) {
-                float dx = ImGui::GetMousePos().x - it->x;
-                float dy = ImGui::GetMousePos().y - it->y;
-                if (std::sqrt(dx * dx + dy * dy) < it->radius + 5.0f) {
-                    it = particleSystem.points.erase(it); 
-                } else {
-                    ++it;
+            for (size_t i = 0; i < frame.pointIds.size(); ++i) {
+                float dx = mousePos.x - frame.points[3 * i];
+                float dy = mousePos.y - frame.points[3 * i + 1];
+                if (std::sqrt(dx * dx + dy * dy) < frame.points[3 * i + 2] + 5.0f) {
+                    simulation.push(DeleteBody{frame.pointIds[i]});
                 }
             }
         }
@@ -133,11 +192,26 @@ int main() {
         if (ImGui::Button("Create Triangle")) {
             Triangle triangle;
 
-            triangle.point1 = {triangleX, triangleY, 5.0f, triangleVX, triangleVY, 0.0f, 0.0f};
-            triangle.point2 = {triangleX + triangleSideLength, triangleY, 5.0f, triangleVX, triangleVY, 0.0f, 0.0f};
-            triangle.point3 = {triangleX + triangleSideLength / 2.0f, triangleY + triangleSideLength * std::sqrt(3.0f) / 2.0f, 5.0f, triangleVX, triangleVY, 0.0f, 0.0f};
+            triangle.point1 = {triangleX, triangleY, 5.0f, triangleVX, triangleVY};
+            triangle.point2 = {triangleX + triangleSideLength, triangleY, 5.0f, triangleVX, triangleVY};
+            triangle.point3 = {triangleX + triangleSideLength / 2.0f, triangleY + triangleSideLength * std::sqrt(3.0f) / 2.0f, 5.0f, triangleVX, triangleVY};
 
-            particleSystem.addTriangle(triangle);
+            simulation.push(SpawnTriangle{triangle});
+        }
+        ImGui::End();
+
+        static float ropeX = 400.0f, ropeY = 50.0f;
+        static float ropeLength = 400.0f;
+        static int ropeLinks = 80;
+
+        ImGui::Begin("Rope Controls");
+        ImGui::SliderFloat("X Position", &ropeX, 0.0f, 1280.0f);
+        ImGui::SliderFloat("Y Position", &ropeY, 0.0f, 720.0f);
+        ImGui::SliderFloat("Length", &ropeLength, 20.0f, 1000.0f);
+        ImGui::SliderInt("Links", &ropeLinks, 2, 1000);
+
+        if (ImGui::Button("Create Rope")) {
+            simulation.push(SpawnRope{ropeX, ropeY, ropeX + ropeLength, ropeY, ropeLinks, 2.0f});
         }
         ImGui::End();
 
@@ -156,25 +230,25 @@ int main() {
             Square square;
             square.sideLength = squareSideLength;
 
-            square.point1 = {squareX, squareY, 5.0f, squareVX, squareVY, 0.0f, 0.0f};
-            square.point2 = {squareX + squareSideLength, squareY, 5.0f, squareVX, squareVY, 0.0f, 0.0f};
-            square.point3 = {squareX + squareSideLength, squareY + squareSideLength, 5.0f, squareVX, squareVY, 0.0f, 0.0f};
-            square.point4 = {squareX, squareY + squareSideLength, 5.0f, squareVX, squareVY, 0.0f, 0.0f};
+            square.point1 = {squareX, squareY, 5.0f, squareVX, squareVY};
+            square.point2 = {squareX + squareSideLength, squareY, 5.0f, squareVX, squareVY};
+            square.point3 = {squareX + squareSideLength, squareY + squareSideLength, 5.0f, squareVX, squareVY};
+            square.point4 = {squareX, squareY + squareSideLength, 5.0f, squareVX, squareVY};
 
-            particleSystem.squares.push_back(square);
+            simulation.push(SpawnSquare{square});
         }
 
         if (ImGui::Button("Delete Selected Square")) {
-            ImVec2 mousePos = ImGui::GetMousePos(); 
-            for (auto it = particleSystem.squares.begin(); it != particleSystem.squares.end(); ++it) {
-                float minX = std::min({it->point1.x, it->point2.x, it->point3.x, it->point4.x});
-                float maxX = std::max({it->point1.x, it->point2.x, it->point3.x, it->point4.x});
-                float minY = std::min({it->point1.y, it->point2.y, it->point3.y, it->point4.y});
-                float maxY = std::max({it->point1.y, it->point2.y, it->point3.y, it->point4.y});
-        
+            for (size_t i = 0; i < frame.squareIds.size(); ++i) {
+                const float* q = &frame.squares[12 * i];
+                float minX = std::min({q[0], q[3], q[6], q[9]});
+                float maxX = std::max({q[0], q[3], q[6], q[9]});
+                float minY = std::min({q[1], q[4], q[7], q[10]});
+                float maxY = std::max({q[1], q[4], q[7], q[10]});
+
                 if (mousePos.x >= minX && mousePos.x <= maxX && mousePos.y >= minY && mousePos.y <= maxY) {
-                    particleSystem.squares.erase(it); 
-                    break; 
+                    simulation.push(DeleteBody{frame.squareIds[i]});
+                    break;
                 }
             }
         }
@@ -186,120 +260,239 @@ int main() {
         static float windStrength = 0.0f;
         ImGui::SliderFloat("Gravity Strength", &gravityStrength, -60.0f, 180.0f);
         ImGui::SliderFloat("Wind Strength", &windStrength,  -50.0f, 50.0f);
-
-        for (auto& p : particleSystem.points) {
-            p.ax =windStrength;
+        static float floorY = 720.0f;
+        ImGui::SliderFloat("Floor Height", &floorY, 100.0f, 720.0f);
+        static int solverIterations = 4;
+        static bool warmStarting = true;
+        static int boundsPolicy = static_cast<int>(BoundsPolicy::Cull);
+        ImGui::SliderInt("Solver Iterations", &solverIterations, 1, 20);
+        ImGui::Checkbox("Warm Starting", &warmStarting);
+        ImGui::Combo("Out of Bounds", &boundsPolicy, "Keep\0Cull\0Recycle\0");
+
+        static float attractorStrength = 0.0f;
+        static float dragCoefficient = 0.0f;
+        ImGui::SliderFloat("Mouse Attractor", &attractorStrength, -500.0f, 500.0f);
+        ImGui::SliderFloat("Air Drag", &dragCoefficient, 0.0f, 2.0f);
+
+        static bool nbodyEnabled = false;
+        static float nbodyStrength = 1000.0f;
+        static float nbodyTheta = 0.5f;
+        ImGui::Checkbox("N-Body Attraction", &nbodyEnabled);
+        ImGui::SliderFloat("N-Body Strength", &nbodyStrength, -5000.0f, 5000.0f);
+        ImGui::SliderFloat("N-Body Theta", &nbodyTheta, 0.1f, 1.5f);
+
+        static float fluidStiffness = 40000.0f;
+        static float fluidViscosity = 10.0f;
+        static int substeps = 1;
+        ImGui::Checkbox("Fluid (SPH)", &fluidEnabled);
+        ImGui::SliderFloat("Fluid Stiffness", &fluidStiffness, 1000.0f, 200000.0f);
+        ImGui::SliderFloat("Fluid Viscosity", &fluidViscosity, 0.0f, 50.0f);
+        ImGui::SliderInt("Substeps", &substeps, 1, 8);
+
+        static bool diagnosticsEnabled = false;
+        ImGui::Checkbox("Energy Diagnostics", &diagnosticsEnabled);
+        static bool jobGraphEnabled = false;
+        ImGui::Checkbox("Job Graph Scheduling", &jobGraphEnabled);
+        static bool incrementalBroadphase = false;
+        ImGui::Checkbox("Incremental Broadphase", &incrementalBroadphase);
+        static int integrator = 0;
+        ImGui::Combo("Particle Integrator", &integrator, "Symplectic Euler\0Position Verlet\0");
+
+        ForceFieldT<Real> gravity = ForceFieldT<Real>::gravity(gravityStrength);
+        gravity.enabled = gravityEnabled;
+        ForceFieldT<Real> attractor = ForceFieldT<Real>::attractor(mousePos.x, mousePos.y, attractorStrength, 400.0f);
+        attractor.enabled = attractorStrength != 0.0f;
+        ForceFieldT<Real> drag = ForceFieldT<Real>::drag(dragCoefficient);
+        drag.enabled = dragCoefficient != 0.0f;
+        simulation.push(SetForceField{gravityField, gravity});
+        simulation.push(SetForceField{windField, ForceFieldT<Real>::wind(windStrength)});
+        simulation.push(SetForceField{attractorField, attractor});
+        simulation.push(SetForceField{dragField, drag});
+
+        SetParameters parameters;
+        parameters.floorY = floorY;
+        parameters.solverIterations = solverIterations;
+        parameters.substeps = substeps;
+        parameters.warmStarting = warmStarting;
+        parameters.boundsPolicy = static_cast<BoundsPolicy>(boundsPolicy);
+        parameters.nbodyEnabled = nbodyEnabled;
+        parameters.nbodyStrength = nbodyStrength;
+        parameters.nbodyTheta = nbodyTheta;
+        parameters.fluidEnabled = fluidEnabled;
+        parameters.fluidStiffness = fluidStiffness;
+        parameters.fluidViscosity = fluidViscosity;
+        parameters.diagnosticsEnabled = diagnosticsEnabled;
+        parameters.jobGraphEnabled = jobGraphEnabled;
+        parameters.incrementalBroadphase = incrementalBroadphase;
+        parameters.integrator = static_cast<Integrator>(integrator);
+        simulation.push(parameters);
+
+        if (jobGraphEnabled) {
+            ImGui::Text("Step graph: %.3f ms, critical path %.3f ms", frame.graphMs, frame.criticalPathMs);
+            ImGui::Text("%s", frame.criticalPath);
         }
-        for (auto& t : particleSystem.triangles) {
-            for (auto* pt : {&t.point1, &t.point2, &t.point3}) {
-                pt->ax = windStrength;
-            }
-        }
-        for (auto& s : particleSystem.squares) {
-            for (auto* pt : {&s.point1, &s.point2, &s.point3, &s.point4}) {
-                pt->ax = windStrength;
+        ImGui::Text("Broadphase reinsertions: %zu", frame.reinsertions);
+
+        ImGui::End();
+
+        // One sample per simulation step seen, kept in a ring for the plots.
+        if (diagnosticsEnabled) {
+            constexpr int historyLength = 300;
+            static float kinetic[historyLength], potential[historyLength], total[historyLength];
+            static float momentum[historyLength], violation[historyLength];
+            static int historyOffset = 0;
+            static uint64_t lastStep = 0;
+            const auto& d = frame.diagnostics;
+            if (frame.step != lastStep) {
+                lastStep = frame.step;
+                kinetic[historyOffset] = d.kineticEnergy;
+                potential[historyOffset] = d.potentialEnergy;
+                total[historyOffset] = d.totalEnergy();
+                momentum[historyOffset] = std::sqrt(d.momentumX * d.momentumX + d.momentumY * d.momentumY);
+                violation[historyOffset] = d.maxConstraintViolation;
+                historyOffset = (historyOffset + 1) % historyLength;
             }
+            auto plot = [&](const char* label, const float* values, float current) {
+                char overlay[32];
+                std::snprintf(overlay, sizeof(overlay), "%.4g", current);
+                ImGui::PlotLines(label, values, historyLength, historyOffset, overlay, FLT_MAX, FLT_MAX, ImVec2(0, 60));
+            };
+            ImGui::Begin("Diagnostics");
+            plot("Kinetic", kinetic, d.kineticEnergy);
+            plot("Potential", potential, d.potentialEnergy);
+            plot("Total", total, d.totalEnergy());
+            plot("|Momentum|", momentum, std::sqrt(d.momentumX * d.momentumX + d.momentumY * d.momentumY));
+            plot("Max Violation", violation, d.maxConstraintViolation);
+            ImGui::Text("Momentum: (%.2f, %.2f)", d.momentumX, d.momentumY);
+            ImGui::End();
         }
-        if (gravityEnabled) {
-            for (auto& p : particleSystem.points) {
-                p.ay = -gravityStrength;
-            }
-            for (auto& square : particleSystem.squares) {
-                for (auto* point : {&square.point1, &square.point2, &square.point3, &square.point4}) {
-                    point->ay = -gravityStrength;
-                }
-            }
+
+        ImGui::Begin("Memory");
+        ImGui::Text("%-12s %12s %12s", "subsystem", "live KB", "peak KB");
+        for (size_t t = 0; t < memoryTagCount; ++t) {
+            const MemoryAccount& account = memoryAccounts[t];
+            ImGui::Text("%-12s %12.1f %12.1f", memoryTagName(static_cast<MemoryTag>(t)), account.live.load() / 1024.0,
+                        account.peak.load() / 1024.0);
         }
+        if (ImGui::Button("Reset Peaks")) resetMemoryPeaks();
+        ImGui::End();
 
+        ImGui::Begin("Camera");
+        ImGui::Text("Centre: (%.0f, %.0f)", camera.centerX, camera.centerY);
+        ImGui::SliderFloat("Zoom", &camera.zoom, camera.minZoom, camera.maxZoom);
+        ImGui::Text(followHandle ? "Following body %u" : "Right-click a body to follow it", followHandle);
+        ImGui::Text("In view: %zu particles, %zu shapes", frame.pointIds.size(), frame.squareIds.size() + frame.triangles.size() / 6);
+        if (ImGui::Button("Reset Camera")) {
+            camera.centerX = 640.0f;
+            camera.centerY = 360.0f;
+            camera.zoom = 1.0f;
+            followHandle = 0;
+        }
+        ImGui::Checkbox("Level of Detail", &levelOfDetail);
+        ImGui::SliderFloat("Sprite Below (px)", &spriteBelow, 0.0f, 8.0f);
+        ImGui::SliderFloat("Splat Below (px)", &splatBelow, 0.0f, 4.0f);
+        static size_t drawnCircles = 0, drawnSprites = 0, drawnCells = 0;
+        ImGui::Text("Drawn: %zu circles, %zu sprites, %zu density cells", drawnCircles, drawnSprites, drawnCells);
         ImGui::End();
 
-        particleSystem.update(DELTATIME, gravityStrength);
+        // The snapshot only holds what overlaps the view, so everything in it is drawn.
+        auto* drawList = ImGui::GetForegroundDrawList();
+        auto screen = [](float x, float y) { return ImVec2(camera.toScreenX(x), camera.toScreenY(y)); };
 
-        for (const auto& p : particleSystem.points) {
-            ImGui::GetForegroundDrawList()->AddCircleFilled(
-                ImVec2(p.x, p.y), p.radius, IM_COL32(255, 0, 0, 255));
+        for (size_t i = 0; i < frame.segments.size(); i += 4) {
+            drawList->AddLine(screen(frame.segments[i], frame.segments[i + 1]),
+                              screen(frame.segments[i + 2], frame.segments[i + 3]), IM_COL32(120, 120, 255, 255), 3.0f);
         }
 
-        for (auto& square : particleSystem.squares) {
-            for (auto& point : {&square.point1, &square.point2, &square.point3, &square.point4}) {
-                ImVec2 mousePos = ImGui::GetMousePos();
-                float dx = mousePos.x - point->x;
-                float dy = mousePos.y - point->y;
-                float distance = std::sqrt(dx * dx + dy * dy);
-
-                if (distance < point->radius + 5.0f) {
-                    ImGui::GetForegroundDrawList()->AddCircle(
-                        ImVec2(point->x, point->y), point->radius + 3.0f, IM_COL32(0, 255, 0, 255), 12, 2.0f);
-                    
+        // Tessellated circles only where they are big enough to look round; smaller particles are
+        // one quad each, and the density grid one quad per covered cell, both batched into a
+        // single reservation.
+        drawnCircles = drawnSprites = 0;
+        float spriteRadius = levelOfDetail ? spriteBelow : 0.0f;
+        for (size_t i = 0; i < frame.points.size(); i += 3) {
+            float r = frame.points[i + 2] * camera.zoom;
+            if (r >= spriteRadius) {
+                drawList->AddCircleFilled(screen(frame.points[i], frame.points[i + 1]), r, IM_COL32(255, 0, 0, 255));
+                ++drawnCircles;
+            } else {
+                ++drawnSprites;
+            }
+        }
+        drawnCells = 0;
+        for (float coverage : frame.density) drawnCells += coverage > 0.0f;
+        if (drawnSprites + drawnCells > 0) {
+            drawList->PrimReserve(static_cast<int>(6 * (drawnSprites + drawnCells)), static_cast<int>(4 * (drawnSprites + drawnCells)));
+            for (size_t i = 0; i < frame.points.size(); i += 3) {
+                float r = frame.points[i + 2] * camera.zoom;
+                if (r >= spriteRadius) continue;
+                // Sprites keep a disc's area: a square of side r * sqrt(pi), at least half a pixel.
+                float half = std::max(r * 0.886f, 0.5f);
+                ImVec2 c = screen(frame.points[i], frame.points[i + 1]);
+                drawList->PrimRect(ImVec2(c.x - half, c.y - half), ImVec2(c.x + half, c.y + half), IM_COL32(255, 0, 0, 255));
+            }
+            float cell = frame.densityCellSize;
+            for (int cy = 0; cy < frame.densityRows; ++cy) {
+                for (int cx = 0; cx < frame.densityCols; ++cx) {
+                    float coverage = frame.density[static_cast<size_t>(cy) * frame.densityCols + cx];
+                    if (coverage <= 0.0f) continue;
+                    ImU32 colour = IM_COL32(255, 0, 0, static_cast<int>(255.0f * std::min(coverage, 1.0f)));
+                    float x = frame.densityX + cx * cell, y = frame.densityY + cy * cell;
+                    drawList->PrimRect(screen(x, y), screen(x + cell, y + cell), colour);
                 }
             }
         }
 
-        for (const auto& triangle : particleSystem.triangles) {
-            auto* drawList = ImGui::GetForegroundDrawList();
-
-            drawList->AddLine(ImVec2(triangle.point1.x, triangle.point1.y),
-            ImVec2(triangle.point2.x, triangle.point2.y),
-            IM_COL32(255, 255, 255, 255), 2.0f);
-
-            drawList->AddLine(ImVec2(triangle.point2.x, triangle.point2.y),
-            ImVec2(triangle.point3.x, triangle.point3.y),
-            IM_COL32(255, 255, 255, 255), 2.0f);
-
-            drawList->AddLine(ImVec2(triangle.point3.x, triangle.point3.y),
-            ImVec2(triangle.point1.x, triangle.point1.y),
-            IM_COL32(255, 255, 255, 255), 2.0f);
-        } 
-
-        for (const auto& square : particleSystem.squares) {
-            auto* drawList = ImGui::GetForegroundDrawList();
-
-            drawList->AddLine(ImVec2(square.point1.x, square.point1.y),
-                              ImVec2(square.point2.x, square.point2.y),
-                              IM_COL32(255, 255, 255, 255), 2.0f);
-
-            drawList->AddLine(ImVec2(square.point2.x, square.point2.y),
-                              ImVec2(square.point3.x, square.point3.y),
-                              IM_COL32(255, 255, 255, 255), 2.0f);
+        for (size_t i = 0; i < frame.triangles.size(); i += 6) {
+            const float* t = &frame.triangles[i];
+            drawList->AddLine(screen(t[0], t[1]), screen(t[2], t[3]), IM_COL32(255, 255, 255, 255), 2.0f);
+            drawList->AddLine(screen(t[2], t[3]), screen(t[4], t[5]), IM_COL32(255, 255, 255, 255), 2.0f);
+            drawList->AddLine(screen(t[4], t[5]), screen(t[0], t[1]), IM_COL32(255, 255, 255, 255), 2.0f);
+        }
 
-            drawList->AddLine(ImVec2(square.point3.x, square.point3.y),
-                              ImVec2(square.point4.x, square.point4.y),
-                              IM_COL32(255, 255, 255, 255), 2.0f);
+        for (size_t c = 0; c + 1 < frame.chainStart.size(); ++c) {
+            for (uint32_t i = frame.chainStart[c]; i + 1 < frame.chainStart[c + 1]; ++i) {
+                drawList->AddLine(screen(frame.chainPoints[2 * i], frame.chainPoints[2 * i + 1]),
+                                  screen(frame.chainPoints[2 * i + 2], frame.chainPoints[2 * i + 3]),
+                                  IM_COL32(230, 180, 80, 255), 2.0f);
+            }
+        }
 
-            drawList->AddLine(ImVec2(square.point4.x, square.point4.y),
-                              ImVec2(square.point1.x, square.point1.y),
-                              IM_COL32(255, 255, 255, 255), 2.0f);
+        for (size_t i = 0; i < frame.squares.size(); i += 12) {
+            const float* q = &frame.squares[i];
+            for (int e = 0; e < 4; ++e) {
+                int n = (e + 1) % 4;
+                drawList->AddLine(screen(q[3 * e], q[3 * e + 1]), screen(q[3 * n], q[3 * n + 1]), IM_COL32(255, 255, 255, 255), 2.0f);
+            }
+            for (int v = 0; v < 4; ++v) {
+                float dx = mousePos.x - q[3 * v];
+                float dy = mousePos.y - q[3 * v + 1];
+                if (std::sqrt(dx * dx + dy * dy) < q[3 * v + 2] + 5.0f) {
+                    drawList->AddCircle(screen(q[3 * v], q[3 * v + 1]), (q[3 * v + 2] + 3.0f) * camera.zoom, IM_COL32(0, 255, 0, 255), 12, 2.0f);
+                }
+            }
         }
 
-        for (auto& square : particleSystem.squares) {
-            for (auto* point : {&square.point1, &square.point2, &square.point3, &square.point4}) {
-                ImVec2 mousePos = ImGui::GetMousePos();
-                float dx = mousePos.x - point->x;
-                float dy = mousePos.y - point->y;
-                float distance = std::sqrt(dx * dx + dy * dy);
-
-                if (distance < point->radius + 5.0f) {
-                    ImGui::GetForegroundDrawList()->AddCircle(
-                        ImVec2(point->x, point->y), point->radius + 3.0f, IM_COL32(0, 255, 0, 255), 12, 2.0f);
-        
-                    if (ImGui::IsMouseDown(0)) {
-                        if (!point->dragged) {
-                            point->dragged = true;
-                            point->vx = 0.0f;
-                            point->vy = 0.0f;
-                            point->ax = 0.0f;
-                            point->ay = 0.0f;
-                            point->offsetX = mousePos.x - point->x;
-                            point->offsetY = mousePos.y - point->y;
+        // A grabbed vertex is named by its square's handle, so it stays attached even if the
+        // simulation reorders or culls other bodies before the commands arrive.
+        static bool dragging = false;
+        if (ImGui::IsMouseDown(0)) {
+            if (dragging) {
+                simulation.push(UpdateDrag{mousePos.x, mousePos.y});
+            } else {
+                for (size_t i = 0; i < frame.squareIds.size() && !dragging; ++i) {
+                    for (uint32_t v = 0; v < 4; ++v) {
+                        const float* q = &frame.squares[12 * i + 3 * v];
+                        float dx = mousePos.x - q[0];
+                        float dy = mousePos.y - q[1];
+                        if (std::sqrt(dx * dx + dy * dy) < q[2] + 5.0f) {
+                            dragging = simulation.push(BeginDrag{frame.squareIds[i], v, mousePos.x, mousePos.y});
+                            break;
                         }
-        
-                        point->x = mousePos.x - point->offsetX;
-                        point->y = mousePos.y - point->offsetY;
-                    } else {
-                        point->dragged = false;
                     }
                 }
             }
+        } else if (dragging) {
+            dragging = !simulation.push(EndDrag{});
         }
 
         ImGui::Render();
@@ -316,6 +509,8 @@ int main() {
         glfwSwapBuffers(window);
     }
 
+    simulation.stop();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -331,14 +526,19 @@ void create_particle(
     float radius,
     float vx,
     float vy,
-    float ax, 
-    float ay,
     float mass,
     float restitution,
     float friction,
     bool fixed,
     float damping
 ) {
-    Point newParticle = {x, y, radius, vx, vy, ax, ay, mass, restitution, friction, fixed, damping};
-    particleSystem.add(newParticle); 
+    MaterialT<Real> material;
+    material.mass = mass;
+    material.restitution = restitution;
+    material.friction = friction;
+    material.damping = damping;
+    Point newParticle = {x, y, radius, vx, vy};
+    newParticle.material = addMaterial(material);
+    newParticle.fixed = fixed;
+    simulation.push(SpawnParticle{newParticle});
 }
\ No newline at end of file
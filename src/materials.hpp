@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+// Surface and mass parameters shared by every point made of the same stuff. Points refer to one
+// by a 16-bit index into `materialTable<S>`, so the physics structs carry no per-point copies.
+template <typename S>
+struct MaterialT {
+    S restitution = S(0.8);
+    S friction = S(0);
+    S damping = S(0.99);
+    S mass = S(1);
+    S inverseMass = S(1);   // set by the table
+};
+
+// Process-wide, append-only and deduplicated: adding parameters that are already registered
+// returns the existing index. Entries live in fixed blocks and never move once added, and `add`
+// only writes slots no published index refers to yet, so any thread may read them without a lock;
+// an index handed to another thread through a queue or a join is safe to use there.
+// Index 0 holds the defaults, which is what a default-constructed point refers to.
+template <typename S>
+struct MaterialTableT {
+    using Material = MaterialT<S>;
+    static constexpr size_t blockSize = 256;
+    static constexpr size_t capacity = 65536;
+
+    Material* blocks[capacity / blockSize] = {};
+    std::mutex mutex;
+    std::map<std::array<S, 4>, uint16_t> lookup;
+    size_t count = 0;
+
+    MaterialTableT() { add(Material{}); }
+    ~MaterialTableT() {
+        for (Material* block : blocks) delete[] block;
+    }
+
+    const Material& operator[](uint16_t index) const {
+        return blocks[index / blockSize][index % blockSize];
+    }
+
+    uint16_t add(Material material) {
+        std::array<S, 4> key{material.restitution, material.friction, material.damping, material.mass};
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = lookup.find(key);
+        if (found != lookup.end()) return found->second;
+        if (count == capacity) throw std::length_error("material table is full");
+        material.inverseMass = material.mass > S(0) ? S(1) / material.mass : S(0);
+        Material*& block = blocks[count / blockSize];
+        if (!block) block = new Material[blockSize];
+        block[count % blockSize] = material;
+        uint16_t index = static_cast<uint16_t>(count++);
+        lookup.emplace(key, index);
+        return index;
+    }
+};
+
+template <typename S>
+inline MaterialTableT<S> materialTable;
+
+template <typename S>
+inline uint16_t addMaterial(const MaterialT<S>& material) { return materialTable<S>.add(material); }
+
+// The material of any point type with a `material` index.
+template <typename P>
+inline const MaterialT<typename P::Scalar>& materialOf(const P& p) { return materialTable<typename P::Scalar>[p.material]; }
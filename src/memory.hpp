@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Process-wide byte counts per engine subsystem. Containers opt in by using a TaggedAllocator,
+// which adds every allocation to its tag's live count and raises the peak when live passes it.
+// Peaks include the moment a growing vector holds both its old and new buffers.
+enum class MemoryTag : uint8_t { Particles, Shapes, Broadphase, Contacts, Render, Fluid, NBody, Geometry, ChainSolver, Scheduler };
+constexpr size_t memoryTagCount = 10;
+
+inline const char* memoryTagName(MemoryTag tag) {
+    static const char* const names[memoryTagCount] = {"particles", "shapes", "broadphase", "contacts", "render",
+                                                      "fluid", "n-body", "geometry", "chain solver", "scheduler"};
+    return names[static_cast<size_t>(tag)];
+}
+
+struct MemoryAccount {
+    std::atomic<int64_t> live{0};
+    std::atomic<int64_t> peak{0};
+};
+
+inline MemoryAccount memoryAccounts[memoryTagCount];
+
+inline MemoryAccount& memoryAccount(MemoryTag tag) { return memoryAccounts[static_cast<size_t>(tag)]; }
+
+inline void recordAllocation(MemoryTag tag, int64_t bytes) {
+    MemoryAccount& account = memoryAccount(tag);
+    int64_t live = account.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = account.peak.load(std::memory_order_relaxed);
+    while (live > peak && !account.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+// Starts a new peak measurement from what is live now.
+inline void resetMemoryPeaks() {
+    for (auto& account : memoryAccounts) account.peak.store(account.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+template <typename T, MemoryTag Tag>
+struct TaggedAllocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind { using other = TaggedAllocator<U, Tag>; };
+
+    TaggedAllocator() = default;
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        T* p = std::allocator<T>().allocate(n);
+        recordAllocation(Tag, static_cast<int64_t>(n * sizeof(T)));
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) {
+        recordAllocation(Tag, -static_cast<int64_t>(n * sizeof(T)));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const TaggedAllocator<U, Tag>&) const { return true; }
+    template <typename U>
+    bool operator!=(const TaggedAllocator<U, Tag>&) const { return false; }
+};
+
+template <typename T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cmath>
+
+// The engine is templated on its scalar type. BOUNCYLABS_SCALAR picks the one the `Point`,
+// `Square`, `Triangle` and `ParticleSystem` aliases use, so each build target can choose.
+#ifndef BOUNCYLABS_SCALAR
+#define BOUNCYLABS_SCALAR float
+#endif
+
+using Real = BOUNCYLABS_SCALAR;
+
+template <typename S>
+inline S scalarSqrt(S v) { return std::sqrt(v); }
+
+template <typename S>
+inline S scalarAbs(S v) { return std::abs(v); }
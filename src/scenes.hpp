@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include "structures.hpp"
+
+// Named headless scenes shared by the benchmark and the ensemble runner.
+
+template <typename S>
+SquareT<S> makeSquare(S x, S y, S side) {
+    SquareT<S> square;
+    square.sideLength = side;
+    square.point1 = {x, y, S(5), S(0), S(0)};
+    square.point2 = {x + side, y, S(5), S(0), S(0)};
+    square.point3 = {x + side, y + side, S(5), S(0), S(0)};
+    square.point4 = {x, y + side, S(5), S(0), S(0)};
+    return square;
+}
+
+template <typename S>
+TriangleT<S> makeTriangle(S x, S y, S side) {
+    TriangleT<S> triangle;
+    triangle.point1 = {x, y, S(5), S(0), S(0)};
+    triangle.point2 = {x + side, y, S(5), S(0), S(0)};
+    triangle.point3 = {x + side / S(2), y + side * scalarSqrt(S(3)) / S(2), S(5), S(0), S(0)};
+    return triangle;
+}
+
+template <typename S>
+void buildScene(ParticleSystemT<S>& world, const std::string& scene, int count) {
+    if (scene != "rope" && scene != "crowd") world.staticGeometry.addWall(S(0), S(0), S(1280), S(720));
+    if (scene != "nbody") world.addForceField(ForceFieldT<S>::gravity(S(98)));
+    if (scene == "particles") {
+        for (int i = 0; i < count; ++i) {
+            S x = S(20 + (i * 37) % 1240);
+            S y = S(20 + (i * 53) % 600);
+            world.add({x, y, S(3), S((i % 11) - 5) * S(10), S(0)});
+        }
+    } else if (scene == "shapes") {
+        for (int i = 0; i < count; ++i) {
+            S x = S(40 + (i % 20) * 60);
+            S y = S(40 + (i / 20) * 60 % 600);
+            if (i % 2 == 0) world.addSquare(makeSquare(x, y, S(40)));
+            else world.addTriangle(makeTriangle(x, y, S(40)));
+        }
+    } else if (scene == "crowd") {
+        for (int i = 0; i < count; ++i) {
+            S x = S(10 + (i % 100) * 12);
+            S y = S(700 - (i / 100) * 12);
+            if (i % 2 == 0) world.addSquare(makeSquare(x, y, S(8)));
+            else world.addTriangle(makeTriangle(x, y, S(8)));
+        }
+    } else if (scene == "nbody") {
+        world.nbody.enabled = true;
+        for (int i = 0; i < count; ++i) {
+            S x = S(40 + (i * 37) % 1200);
+            S y = S(40 + (i * 53) % 640);
+            world.add({x, y, S(2), S(0), S(0)});
+        }
+    } else if (scene == "fluid") {
+        world.fluid.enabled = true;
+        S spacing = world.fluid.spacing;
+        int cols = 600 / static_cast<int>(spacing);
+        MaterialT<S> water;
+        water.restitution = S(0.1);
+        water.damping = S(1);
+        uint16_t material = addMaterial(water);
+        for (int i = 0; i < count; ++i) {
+            PointT<S> p{S(10) + spacing * S(i % cols), S(700) - spacing * S(i / cols), spacing / S(2), S(0), S(0)};
+            p.material = material;
+            world.add(p);
+        }
+        for (int i = 0; i < 4; ++i) world.addSquare(makeSquare(S(800 + i * 100), S(300), S(60)));
+    } else if (scene == "rope") {
+        world.floorY = S(1e6);
+        world.addChain(ChainT<S>::between(S(0), S(0), S(5 * count), S(0), count, S(2)));
+    } else if (scene == "stack") {
+        for (int i = 0; i < count; ++i) world.addSquare(makeSquare(S(600), S(660 - i * 52), S(50)));
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "commands.hpp"
+#include "memory.hpp"
+#include "spscqueue.hpp"
+#include "structures.hpp"
+#include "triplebuffer.hpp"
+
+// Everything the renderer needs from one simulation step, in plain float arrays. The vectors keep
+// their capacity between captures, so publishing a frame does not allocate once the scene is stable.
+struct RenderSnapshot {
+    template <typename T>
+    using Vector = TaggedVector<T, MemoryTag::Render>;
+
+    Vector<float> points;       // x, y, radius
+    Vector<uint32_t> pointIds;
+    Vector<float> triangles;    // three vertices of x, y
+    Vector<float> squares;      // four vertices of x, y, radius
+    Vector<uint32_t> squareIds;
+    Vector<uint32_t> chainStart;
+    Vector<float> chainPoints;  // x, y
+    Vector<float> segments;     // x1, y1, x2, y2
+    // Particles too small to draw one by one: the fraction of each grid cell their discs cover,
+    // row by row over a grid of densityCols × densityRows cells from (densityX, densityY).
+    Vector<float> density;
+    int densityCols = 0, densityRows = 0;
+    float densityX = 0.0f, densityY = 0.0f, densityCellSize = 0.0f;
+    uint64_t step = 0;
+    double stepMs = 0.0;
+    DiagnosticsT<float> diagnostics;    // zero unless the world has diagnostics enabled
+    // Last step's job graph, when the world runs one: wall time, critical path and its stages.
+    float graphMs = 0.0f, criticalPathMs = 0.0f;
+    char criticalPath[160] = "";
+    size_t reinsertions = 0;            // shapes the broadphase binned again in the last step
+};
+
+// Copies the bodies that overlap `view` into `out`. Shapes are found through the broadphase grid
+// of the last step, so the cost follows what is in view rather than the size of the world; the
+// grid's boxes predate the contact solve, so the view is padded to cover what it moved since.
+template <typename S>
+void captureSnapshot(const ParticleSystemT<S>& world, RenderSnapshot& out, const SetViewT<S>& view = {}) {
+    auto f = [](S v) { return static_cast<float>(v); };
+    auto inView = [&](S minX, S minY, S maxX, S maxY) {
+        return minX <= view.maxX && view.minX <= maxX && minY <= view.maxY && view.minY <= maxY;
+    };
+    out.points.clear();
+    out.pointIds.clear();
+    out.densityCols = out.densityRows = 0;
+    out.density.clear();
+    bool splat = view.splatRadius > S(0) && view.splatCell > S(0);
+    if (splat) {
+        out.densityCols = static_cast<int>((view.maxX - view.minX) / view.splatCell) + 1;
+        out.densityRows = static_cast<int>((view.maxY - view.minY) / view.splatCell) + 1;
+        splat = out.densityCols > 0 && out.densityRows > 0 && int64_t(out.densityCols) * out.densityRows <= (int64_t(1) << 22);
+    }
+    if (splat) {
+        out.densityX = f(view.minX);
+        out.densityY = f(view.minY);
+        out.densityCellSize = f(view.splatCell);
+        out.density.assign(static_cast<size_t>(out.densityCols) * out.densityRows, 0.0f);
+    } else {
+        out.densityCols = out.densityRows = 0;
+    }
+    const S coverage = splat ? S(3.14159265) / (view.splatCell * view.splatCell) : S(0);
+    for (const auto& p : world.points) {
+        if (!inView(p.x - p.radius, p.y - p.radius, p.x + p.radius, p.y + p.radius)) continue;
+        if (splat && p.radius < view.splatRadius) {
+            int cx = std::clamp(static_cast<int>((p.x - view.minX) / view.splatCell), 0, out.densityCols - 1);
+            int cy = std::clamp(static_cast<int>((p.y - view.minY) / view.splatCell), 0, out.densityRows - 1);
+            out.density[static_cast<size_t>(cy) * out.densityCols + cx] += f(p.radius * p.radius * coverage);
+            continue;
+        }
+        out.points.insert(out.points.end(), {f(p.x), f(p.y), f(p.radius)});
+        out.pointIds.push_back(p.id);
+    }
+    out.triangles.clear();
+    out.squares.clear();
+    out.squareIds.clear();
+    auto addTriangle = [&](const TriangleT<S>& t) {
+        for (const auto* p : t.vertices()) out.triangles.insert(out.triangles.end(), {f(p->x), f(p->y)});
+    };
+    auto addSquare = [&](const SquareT<S>& s) {
+        for (const auto* p : s.vertices()) out.squares.insert(out.squares.end(), {f(p->x), f(p->y), f(p->radius)});
+        out.squareIds.push_back(s.id);
+    };
+    size_t split = world.triangles.size();
+    if (world.broadphase.boxes.size() == split + world.squares.size()) {
+        const S pad = S(16);
+        world.broadphase.query({view.minX - pad, view.minY - pad, view.maxX + pad, view.maxY + pad}, [&](uint32_t i) {
+            if (i < split) addTriangle(world.triangles[i]);
+            else addSquare(world.squares[i - split]);
+        });
+    } else {
+        // Shapes were culled after the broadphase ran, so its indices no longer line up.
+        for (const auto& t : world.triangles) addTriangle(t);
+        for (const auto& s : world.squares) addSquare(s);
+    }
+    out.chainStart.assign(1, 0);
+    out.chainPoints.clear();
+    for (const auto& c : world.chains) {
+        if (c.points.empty()) continue;
+        S minX = c.points[0].x, minY = c.points[0].y, maxX = minX, maxY = minY;
+        for (const auto& p : c.points) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        if (!inView(minX, minY, maxX, maxY)) continue;
+        for (const auto& p : c.points) out.chainPoints.insert(out.chainPoints.end(), {f(p.x), f(p.y)});
+        out.chainStart.push_back(static_cast<uint32_t>(out.chainPoints.size() / 2));
+    }
+    out.segments.clear();
+    for (const auto& s : world.staticGeometry.segments) {
+        out.segments.insert(out.segments.end(), {f(s.x1), f(s.y1), f(s.x2), f(s.y2)});
+    }
+    const auto& d = world.diagnostics;
+    out.diagnostics = {f(d.kineticEnergy), f(d.potentialEnergy), f(d.momentumX), f(d.momentumY), f(d.maxConstraintViolation)};
+    out.reinsertions = world.broadphase.reinsertions;
+    const JobGraph& graph = world.jobGraph;
+    bool scheduled = world.jobGraphEnabled && !graph.jobs.empty();
+    out.graphMs = scheduled ? static_cast<float>(graph.wallMs) : 0.0f;
+    out.criticalPathMs = scheduled ? static_cast<float>(graph.criticalPathMs) : 0.0f;
+    if (scheduled) graph.describeCriticalPath(out.criticalPath, sizeof(out.criticalPath));
+    else out.criticalPath[0] = '\0';
+}
+
+// Runs a world on its own thread at a fixed step, publishing a snapshot after every tick through a
+// triple buffer. Other threads must not touch `world` once started; one thread hands changes to
+// `push`, and the simulation drains the queue at the start of every step.
+template <typename S>
+struct SimulationT {
+    using World = ParticleSystemT<S>;
+    using Clock = std::chrono::steady_clock;
+
+    World world;
+    S dt = S(0.016);
+    int maxStepsPerTick = 4;
+    TripleBuffer<RenderSnapshot> snapshots;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    SpscQueue<CommandT<S>, 1024> commands;
+    CommandProcessorT<S> processor;
+    uint64_t steps = 0;
+
+    ~SimulationT() { stop(); }
+
+    void start() {
+        if (running.exchange(true)) return;
+        thread = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        thread.join();
+    }
+
+    // Returns false, dropping the command, when the simulation has fallen a full queue behind.
+    bool push(const CommandT<S>& command) { return commands.push(command); }
+
+    // Newest complete state; stays valid until the next call.
+    const RenderSnapshot& latest() {
+        snapshots.acquire();
+        return snapshots.readSlot();
+    }
+
+    void drainCommands() {
+        CommandT<S> command;
+        while (commands.pop(command)) processor.apply(world, command);
+    }
+
+    void run() {
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(dt)));
+        auto next = Clock::now();
+        double stepMs = 0.0;
+        while (running.load(std::memory_order_relaxed)) {
+            auto now = Clock::now();
+            if (now < next) {
+                std::this_thread::sleep_until(next);
+                continue;
+            }
+            for (int i = 0; i < maxStepsPerTick && next <= now; ++i) {
+                drainCommands();
+                auto begin = Clock::now();
+                world.update(dt);
+                stepMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+                ++steps;
+                next += period;
+            }
+            // When steps take longer than real time, drop the backlog rather than spiralling.
+            if (next <= now) next = now + period;
+
+            RenderSnapshot& frame = snapshots.writeSlot();
+            captureSnapshot(world, frame, processor.view);
+            frame.step = steps;
+            frame.stepMs = stepMs;
+            snapshots.publish();
+        }
+    }
+};
+
+using Simulation = SimulationT<Real>;
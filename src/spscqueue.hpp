@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free single-producer/single-consumer ring. `push` fails instead of waiting when the
+// ring is full, and `pop` fails when it is empty. The two indices only ever grow; they sit on
+// separate cache lines so the producer and consumer do not false-share.
+template <typename T, size_t Capacity>
+struct SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+    static constexpr size_t mask = Capacity - 1;
+
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> head{0};    // next slot to read, owned by the consumer
+    alignas(64) std::atomic<size_t> tail{0};    // next slot to write, owned by the producer
+
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        out = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+};
@@ -1,213 +1,1150 @@
+#pragma once
+
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include "scalar.hpp"
+#include "geometry.hpp"
+#include "contacts.hpp"
+#include "forces.hpp"
+#include "barneshut.hpp"
+#include "fluid.hpp"
+#include "chain.hpp"
+#include "broadphase.hpp"
+#include "threading.hpp"
+#include "diagnostics.hpp"
+#include "memory.hpp"
+#include "jobgraph.hpp"
+#include "materials.hpp"
+
+template <typename S>
+struct PointT {
+    using Scalar = S;
 
-struct Point {
-    float x, y;
-    float radius;
-    float vx, vy;
-    float ax, ay;
-    float mass = 1.0f;
-    float restitution = 0.8f;
-    float friction = 0;
+    S x, y;
+    S radius;
+    S vx, vy;
+    uint32_t id = 0;        // handle of a free particle; 0 for the vertices of shapes and chains
+    uint16_t material = 0;  // index into materialTable<S>; mass, restitution, friction and damping live there
     bool fixed = false;
-    float damping = 0.99f;
-    bool dragged = false;
-    float offsetX = 0.0f;
-    float offsetY = 0.0f;
 };
 
-struct Square {
+template <typename S>
+struct SquareT {
+    using Point = PointT<S>;
+
+    uint32_t id = 0;
     Point point1, point2, point3, point4;
-    float sideLength = 5.0f;
+    S sideLength = S(5);
+
+    std::array<Point*, 4> vertices() { return {&point1, &point2, &point3, &point4}; }
+    std::array<const Point*, 4> vertices() const { return {&point1, &point2, &point3, &point4}; }
 
+    // Snaps the vertices back onto a square of `sideLength` with the same centroid, turned to fit
+    // them best and wound the way they are. A square with a pinned or dragged vertex is relaxed
+    // side by side instead, so that vertex stays where it is.
     void enforceConstraints() {
-        auto enforceDistance = [](Point& p1, Point& p2, float targetDistance) {
-            float dx = p2.x - p1.x;
-            float dy = p2.y - p1.y;
-            float dist = std::sqrt(dx * dx + dy * dy);
-            if (dist == 0.0f) return;
-            float diff = (dist - targetDistance) / dist;
-            if (!p1.fixed) { p1.x += dx * 0.5f * diff; p1.y += dy * 0.5f * diff; }
-            if (!p2.fixed) { p2.x -= dx * 0.5f * diff; p2.y -= dy * 0.5f * diff; }
+        auto verts = vertices();
+        S cx = (point1.x + point2.x + point3.x + point4.x) / S(4);
+        S cy = (point1.y + point2.y + point3.y + point4.y) / S(4);
+        S h = sideLength / S(2);
+        S winding = signedArea(verts.data(), 4) >= S(0) ? S(1) : S(-1);
+        const S restX[4] = {-h, h, h, -h};
+        const S restY[4] = {-h * winding, -h * winding, h * winding, h * winding};
+        S dot = S(0), cross = S(0);
+        for (int i = 0; i < 4; ++i) {
+            S qx = verts[i]->x - cx, qy = verts[i]->y - cy;
+            dot += restX[i] * qx + restY[i] * qy;
+            cross += restX[i] * qy - restY[i] * qx;
+        }
+        S length = scalarSqrt(dot * dot + cross * cross);
+        if (point1.fixed || point2.fixed || point3.fixed || point4.fixed || length == S(0)) {
+            for (int i = 0; i < 10; ++i) relax();
+            return;
+        }
+        S c = dot / length, sn = cross / length;
+        for (int i = 0; i < 4; ++i) {
+            verts[i]->x = cx + c * restX[i] - sn * restY[i];
+            verts[i]->y = cy + sn * restX[i] + c * restY[i];
+        }
+    }
+
+    void relax() {
+        auto enforceDistance = [](Point& p1, Point& p2, S targetDistance) {
+            S dx = p2.x - p1.x;
+            S dy = p2.y - p1.y;
+            S dist = scalarSqrt(dx * dx + dy * dy);
+            if (dist == S(0)) return;
+            S diff = (dist - targetDistance) / dist;
+            if (!p1.fixed) { p1.x += dx * S(0.5) * diff; p1.y += dy * S(0.5) * diff; }
+            if (!p2.fixed) { p2.x -= dx * S(0.5) * diff; p2.y -= dy * S(0.5) * diff; }
         };
         enforceDistance(point1, point2, sideLength);
         enforceDistance(point2, point3, sideLength);
         enforceDistance(point3, point4, sideLength);
         enforceDistance(point4, point1, sideLength);
-        float diagonal = sideLength * std::sqrt(2.0f);
+        S diagonal = sideLength * scalarSqrt(S(2));
         enforceDistance(point1, point3, diagonal);
         enforceDistance(point2, point4, diagonal);
     }
+
+    // Largest relative deviation of any side or diagonal from its rest length.
+    S maxStretch() const {
+        auto stretch = [](const Point& p1, const Point& p2, S target) {
+            S dx = p2.x - p1.x, dy = p2.y - p1.y;
+            return scalarAbs(scalarSqrt(dx * dx + dy * dy) - target) / target;
+        };
+        S diagonal = sideLength * scalarSqrt(S(2));
+        return std::max({stretch(point1, point2, sideLength), stretch(point2, point3, sideLength),
+                         stretch(point3, point4, sideLength), stretch(point4, point1, sideLength),
+                         stretch(point1, point3, diagonal), stretch(point2, point4, diagonal)});
+    }
 };
 
-struct Triangle {
+template <typename S>
+struct TriangleT {
+    using Point = PointT<S>;
+
+    uint32_t id = 0;
     Point point1, point2, point3;
 
+    std::array<Point*, 3> vertices() { return {&point1, &point2, &point3}; }
+    std::array<const Point*, 3> vertices() const { return {&point1, &point2, &point3}; }
+
     void enforceConstraints() {
-        auto enforceDistance = [](Point& p1, Point& p2, float targetDistance) {
-            float dx = p2.x - p1.x;
-            float dy = p2.y - p1.y;
-            float dist = std::sqrt(dx * dx + dy * dy);
-            if (dist == 0.0f) return;
-            float diff = (dist - targetDistance) / dist;
-            if (!p1.fixed) { p1.x += dx * 0.5f * diff; p1.y += dy * 0.5f * diff; }
-            if (!p2.fixed) { p2.x -= dx * 0.5f * diff; p2.y -= dy * 0.5f * diff; }
+        auto enforceDistance = [](Point& p1, Point& p2, S targetDistance) {
+            S dx = p2.x - p1.x;
+            S dy = p2.y - p1.y;
+            S dist = scalarSqrt(dx * dx + dy * dy);
+            if (dist == S(0)) return;
+            S diff = (dist - targetDistance) / dist;
+            if (!p1.fixed) { p1.x += dx * S(0.5) * diff; p1.y += dy * S(0.5) * diff; }
+            if (!p2.fixed) { p2.x -= dx * S(0.5) * diff; p2.y -= dy * S(0.5) * diff; }
         };
-        float a = std::sqrt((point1.x - point2.x)*(point1.x - point2.x) + (point1.y - point2.y)*(point1.y - point2.y));
-        float b = std::sqrt((point2.x - point3.x)*(point2.x - point3.x) + (point2.y - point3.y)*(point2.y - point3.y));
-        float c = std::sqrt((point3.x - point1.x)*(point3.x - point1.x) + (point3.y - point1.y)*(point3.y - point1.y));
+        S a = scalarSqrt((point1.x - point2.x)*(point1.x - point2.x) + (point1.y - point2.y)*(point1.y - point2.y));
+        S b = scalarSqrt((point2.x - point3.x)*(point2.x - point3.x) + (point2.y - point3.y)*(point2.y - point3.y));
+        S c = scalarSqrt((point3.x - point1.x)*(point3.x - point1.x) + (point3.y - point1.y)*(point3.y - point1.y));
         enforceDistance(point1, point2, a);
         enforceDistance(point2, point3, b);
         enforceDistance(point3, point1, c);
     }
 };
 
-struct ParticleSystem {
-    std::vector<Point> points;
-    std::vector<Square> squares;
-    std::vector<Triangle> triangles;
-    bool gravityEnabled = true; 
+// A rope: points joined by inextensible links, kept at length by direct tridiagonal solves.
+// Chains take part in the floor, static geometry and bounds, but not in shape contacts. Links
+// should stay longer than the distance a point travels in one step (a few pixels at 60 Hz).
+template <typename S>
+struct ChainT {
+    using Point = PointT<S>;
+
+    uint32_t id = 0;
+    TaggedVector<Point, MemoryTag::Shapes> points;
+    TaggedVector<S, MemoryTag::Shapes> restLengths;
+    TaggedVector<S, MemoryTag::Shapes> startX, startY;
+    int iterations = 2;
+    ChainSolverT<S> solver;
+
+    // `links` equal links from (x1, y1) to (x2, y2); the first point is pinned when `anchored`.
+    static ChainT between(S x1, S y1, S x2, S y2, int links, S radius, bool anchored = true) {
+        ChainT chain;
+        links = std::max(links, 1);
+        S length = scalarSqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1)) / S(links);
+        for (int i = 0; i <= links; ++i) {
+            S t = S(i) / S(links);
+            chain.points.push_back({x1 + (x2 - x1) * t, y1 + (y2 - y1) * t, radius, S(0), S(0)});
+        }
+        chain.points.front().fixed = anchored;
+        chain.restLengths.assign(links, length);
+        return chain;
+    }
+
+    std::vector<Point*> vertices() {
+        std::vector<Point*> out;
+        for (auto& p : points) out.push_back(&p);
+        return out;
+    }
+
+    void beginStep() {
+        startX.resize(points.size());
+        startY.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) { startX[i] = points[i].x; startY[i] = points[i].y; }
+    }
+
+    void enforceConstraints(S dt) { solver.step(points, startX, startY, restLengths, iterations, dt); }
+
+    // Largest relative deviation of any link from its rest length.
+    S maxStretch() const {
+        S worst = S(0);
+        for (size_t i = 0; i < restLengths.size(); ++i) {
+            S dx = points[i + 1].x - points[i].x, dy = points[i + 1].y - points[i].y;
+            worst = std::max(worst, scalarAbs(scalarSqrt(dx * dx + dy * dy) - restLengths[i]) / restLengths[i]);
+        }
+        return worst;
+    }
+};
+
+// How free particles advance. Position Verlet keeps each particle's previous position in place of
+// its velocity; shapes and chains always use symplectic Euler.
+enum class Integrator { SymplecticEuler, Verlet };
+
+template <typename S>
+struct ParticleSystemT {
+    using Scalar = S;
+    using Point = PointT<S>;
+    using Square = SquareT<S>;
+    using Triangle = TriangleT<S>;
+    using Chain = ChainT<S>;
+    using Segment = SegmentT<S>;
+    using ContactCache = ContactCacheT<S>;
+    using RigidBody = RigidBodyT<S>;
+    using BodyPair = typename BroadphaseT<S>::Pair;
+    using Diagnostics = DiagnosticsT<S>;
+
+    TaggedVector<Point, MemoryTag::Particles> points;
+    TaggedVector<Square, MemoryTag::Shapes> squares;
+    TaggedVector<Triangle, MemoryTag::Shapes> triangles;
+    TaggedVector<Chain, MemoryTag::Shapes> chains;
+    std::vector<ForceFieldT<S>> forceFields;
+    std::vector<const ForceFieldT<S>*> localFields;
+    UniformForceT<S> uniformForce;
+    BarnesHutT<S> nbody;
+    FluidT<S> fluid;
+    BroadphaseT<S> broadphase;
+    TaggedVector<S, MemoryTag::Particles> extraAx, extraAy;
+    ThreadPool* threadPool = nullptr;
+    S floorY = S(720);
+    StaticGeometryT<S> staticGeometry;
+    WorldBoundsT<S> bounds;
+    ContactCache contactCache;
+    template <typename T>
+    using ContactVector = TaggedVector<T, MemoryTag::Contacts>;
+    ContactVector<Manifold<Point>> manifolds;
+    ContactVector<uint64_t> manifoldKeys;
+    ContactVector<BodyPair> manifoldBodies;
+    ContactVector<ContactVector<Manifold<Point>>> chunkManifolds;
+    ContactVector<ContactVector<BodyPair>> chunkManifoldBodies;
+    ContactVector<uint64_t> bodyColours;
+    ContactVector<uint8_t> manifoldColour;
+    ContactVector<uint32_t> colourStart, colourOrder;
+    ContactVector<RigidBody> rigidBodies;   // one per shape as in the broadphase boxes, then the ground
+    int solverIterations = 4;
+    int substeps = 1;
+    bool warmStarting = true;
+    // Spreads integration and the contact solve over `threadPool`. Contacts are solved one colour
+    // at a time instead of in pair order, so results differ from the serial solver, but they are
+    // bit-identical from run to run and for any thread count.
+    bool deterministicParallel = false;
+    S contactMargin = S(1);
+    S restitutionThreshold = S(10);     // slower impacts of shapes rest instead of bouncing
+    uint32_t nextBodyId = 1;
+    // When set, the integrator also fills `diagnostics` for the last (sub)step as it goes. Each body
+    // kind sums into its own stage partial, merged in a fixed order at the end of the step.
+    bool diagnosticsEnabled = false;
+    Diagnostics diagnostics;
+    std::array<Diagnostics, 4> stageDiagnostics;
+    std::array<std::vector<Diagnostics>, 4> blockDiagnostics;
+    static constexpr size_t blockSize = 64;
+    // When set, each step runs as a JobGraph on `threadPool`: the body kinds integrate concurrently
+    // and shape contacts are solved while free points are still integrating. Stages still split
+    // their own loops across the pool. `jobGraph` keeps the last step's timings and critical path.
+    bool jobGraphEnabled = false;
+    JobGraph jobGraph;
+    // Once a Verlet step has run, the free particles' vx, vy hold where they were one step of
+    // `verletDt` earlier. Read and write their velocities through `velocityOf` and `setVelocity`;
+    // the particles switch back to holding velocities at the first step in the other mode.
+    Integrator integrator = Integrator::SymplecticEuler;
+    bool pointsHoldPrevious = false;
+    S verletDt = S(0);
+
+    void velocityOf(const Point& p, S& vx, S& vy) const {
+        if (pointsHoldPrevious) { vx = (p.x - p.vx) / verletDt; vy = (p.y - p.vy) / verletDt; }
+        else { vx = p.vx; vy = p.vy; }
+    }
+
+    void setVelocity(Point& p, S vx, S vy) const {
+        if (pointsHoldPrevious) { p.vx = p.x - vx * verletDt; p.vy = p.y - vy * verletDt; }
+        else { p.vx = vx; p.vy = vy; }
+    }
+
+    S verletInverseDt() const { return pointsHoldPrevious ? S(1) / verletDt : S(0); }
+
+    void storePreviousPositions(S dt) {
+        verletDt = dt;
+        for (auto& p : points) { p.vx = p.x - p.vx * dt; p.vy = p.y - p.vy * dt; }
+        pointsHoldPrevious = true;
+    }
+
+    void storeVelocities() {
+        for (auto& p : points) velocityOf(p, p.vx, p.vy);
+        pointsHoldPrevious = false;
+    }
+
+    // Bodies the user is holding, keyed by handle. The held vertex is pinned through `fixed` for the
+    // duration, so the physics needs no per-point interaction state.
+    struct Drag {
+        size_t vertex;
+        S offsetX, offsetY;     // from the vertex to the cursor
+        bool wasFixed;
+    };
+    std::unordered_map<uint32_t, Drag> drags;
+
+    // Body kinds, in the order `integrate` handles them and indexing the per-kind arrays below.
+    static constexpr size_t pointKind = 0, triangleKind = 1, chainKind = 2, squareKind = 3;
+
+    // How many vertices of each kind are pinned and how many use a damped material. Every method
+    // that adds, removes, drags or re-materials a body keeps these current, so a step picks each
+    // kind's integrator instantiation without looking at the points.
+    struct FlagCounts {
+        size_t fixed = 0, damped = 0;
+    };
+    std::array<FlagCounts, 4> flagCounts;
+
+    void track(size_t kind, const Point& p, bool adding) {
+        FlagCounts& counts = flagCounts[kind];
+        size_t fixed = p.fixed ? 1 : 0, damped = materialOf(p).damping != S(1) ? 1 : 0;
+        if (adding) { counts.fixed += fixed; counts.damped += damped; }
+        else { counts.fixed -= fixed; counts.damped -= damped; }
+    }
+    void track(const Point& p, bool adding) { track(pointKind, p, adding); }
+    void track(const Triangle& t, bool adding) { for (const auto* pt : t.vertices()) track(triangleKind, *pt, adding); }
+    void track(const Square& s, bool adding) { for (const auto* pt : s.vertices()) track(squareKind, *pt, adding); }
+    void track(const Chain& c, bool adding) { for (const auto& pt : c.points) track(chainKind, pt, adding); }
+
+    // Call after setting `fixed` or `material` on bodies directly rather than through the world.
+    void recountFlags() {
+        flagCounts.fill(FlagCounts{});
+        for (const auto& p : points) track(p, true);
+        for (const auto& t : triangles) track(t, true);
+        for (const auto& s : squares) track(s, true);
+        for (const auto& c : chains) track(c, true);
+    }
+
+    // Gives every vertex of the body with this handle the material. Returns false when it no longer exists.
+    bool setMaterial(uint32_t id, uint16_t material) {
+        for (size_t vertex = 0;; ++vertex) {
+            size_t kind;
+            Point* p = bodyVertex(id, vertex, &kind);
+            if (!p) return vertex > 0;
+            track(kind, *p, false);
+            p->material = material;
+            track(kind, *p, true);
+        }
+    }
+
+    bool beginDrag(uint32_t id, size_t vertex, S x, S y) {
+        size_t kind;
+        Point* p = bodyVertex(id, vertex, &kind);
+        if (!p) return false;
+        endDrag(id);
+        drags[id] = {vertex, x - p->x, y - p->y, p->fixed};
+        track(kind, *p, false);
+        p->fixed = true;
+        track(kind, *p, true);
+        if (kind == pointKind) setVelocity(*p, S(0), S(0));
+        else p->vx = p->vy = S(0);
+        return true;
+    }
+
+    void updateDrag(uint32_t id, S x, S y) {
+        auto found = drags.find(id);
+        if (found == drags.end()) return;
+        if (Point* p = bodyVertex(id, found->second.vertex)) {
+            p->x = x - found->second.offsetX;
+            p->y = y - found->second.offsetY;
+        }
+    }
+
+    void endDrag(uint32_t id) {
+        auto found = drags.find(id);
+        if (found == drags.end()) return;
+        size_t kind;
+        if (Point* p = bodyVertex(id, found->second.vertex, &kind)) {
+            track(kind, *p, false);
+            p->fixed = found->second.wasFixed;
+            track(kind, *p, true);
+        }
+        drags.erase(found);
+    }
+
+    uint32_t add(const Point& p) {
+        points.push_back(p);
+        points.back().id = nextBodyId++;
+        setVelocity(points.back(), p.vx, p.vy);
+        track(p, true);
+        fluid.invalidate();
+        return points.back().id;
+    }
+
+    size_t addForceField(const ForceFieldT<S>& field) {
+        forceFields.push_back(field);
+        return forceFields.size() - 1;
+    }
+
+    ForceFieldT<S>& forceField(size_t handle) { return forceFields[handle]; }
+    uint32_t addSquare(const Square& s) { squares.push_back(s); track(s, true); return squares.back().id = nextBodyId++; }
+    uint32_t addTriangle(const Triangle& t) { triangles.push_back(t); track(t, true); return triangles.back().id = nextBodyId++; }
+    uint32_t addChain(const Chain& c) { chains.push_back(c); track(c, true); return chains.back().id = nextBodyId++; }
+
+    // Removes the particle, shape or chain with this handle. Returns false when it no longer exists.
+    bool remove(uint32_t id) {
+        endDrag(id);
+        auto erase = [&](auto& bodies) {
+            auto it = std::find_if(bodies.begin(), bodies.end(), [id](const auto& b) { return b.id == id; });
+            if (it == bodies.end()) return false;
+            track(*it, false);
+            bodies.erase(it);
+            return true;
+        };
+        if (erase(points)) {
+            fluid.invalidate();
+            return true;
+        }
+        return erase(squares) || erase(triangles) || erase(chains);
+    }
 
-    void add(const Point& p) { points.push_back(p); }
-    void addSquare(const Square& s) { squares.push_back(s); }
-    void addTriangle(const Triangle& t) { triangles.push_back(t); }
+    // Vertex `vertex` of the body with this handle (a particle's only vertex is 0), or null. The
+    // body's kind goes to `kind` when it is given.
+    Point* bodyVertex(uint32_t id, size_t vertex, size_t* kind = nullptr) {
+        size_t found = pointKind;
+        auto find = [&](auto& bodies, size_t bodyKind) -> Point* {
+            for (auto& b : bodies) {
+                if (b.id != id) continue;
+                found = bodyKind;
+                auto verts = b.vertices();
+                return vertex < verts.size() ? verts[vertex] : nullptr;
+            }
+            return nullptr;
+        };
+        Point* p = nullptr;
+        for (auto& q : points) if (q.id == id) p = vertex == 0 ? &q : nullptr;
+        if (!p) p = find(squares, squareKind);
+        if (!p) p = find(triangles, triangleKind);
+        if (!p) p = find(chains, chainKind);
+        if (p && kind) *kind = found;
+        return p;
+    }
 
     void checkAndResolveCollision(Point& p, Point& edgeStart, Point& edgeEnd) {
-        float edgeDx = edgeEnd.x - edgeStart.x;
-        float edgeDy = edgeEnd.y - edgeStart.y;
-        float pointDx = p.x - edgeStart.x;
-        float pointDy = p.y - edgeStart.y;
-        float edgeLengthSquared = edgeDx * edgeDx + edgeDy * edgeDy;
-        if (edgeLengthSquared == 0) return;
-        float projection = (pointDx * edgeDx + pointDy * edgeDy) / edgeLengthSquared;
-        projection = std::max(0.0f, std::min(1.0f, projection));
-        float closestX = edgeStart.x + projection * edgeDx;
-        float closestY = edgeStart.y + projection * edgeDy;
-        float distX = p.x - closestX;
-        float distY = p.y - closestY;
-        float distanceSquared = distX * distX + distY * distY;
+        S edgeDx = edgeEnd.x - edgeStart.x;
+        S edgeDy = edgeEnd.y - edgeStart.y;
+        S pointDx = p.x - edgeStart.x;
+        S pointDy = p.y - edgeStart.y;
+        S edgeLengthSquared = edgeDx * edgeDx + edgeDy * edgeDy;
+        if (edgeLengthSquared == S(0)) return;
+        S projection = (pointDx * edgeDx + pointDy * edgeDy) / edgeLengthSquared;
+        projection = std::max(S(0), std::min(S(1), projection));
+        S closestX = edgeStart.x + projection * edgeDx;
+        S closestY = edgeStart.y + projection * edgeDy;
+        S distX = p.x - closestX;
+        S distY = p.y - closestY;
+        S distanceSquared = distX * distX + distY * distY;
         if (distanceSquared < p.radius * p.radius) {
-            float distance = std::sqrt(distanceSquared);
-            float overlap = p.radius - distance;
+            S distance = scalarSqrt(distanceSquared);
+            S overlap = p.radius - distance;
             if (distance > 0) { p.x += (distX / distance) * overlap; p.y += (distY / distance) * overlap; }
             else { p.x += overlap; p.y += overlap; }
-            float normalX = distance > 0 ? distX / distance : 1.0f;
-            float normalY = distance > 0 ? distY / distance : 0.0f;
-            float dotProduct = p.vx * normalX + p.vy * normalY;
-            p.vx -= 2 * dotProduct * normalX;
-            p.vy -= 2 * dotProduct * normalY;
-            p.vx *= p.restitution;
-            p.vy *= p.restitution;
-        }
-    }
-
-    void update(float dt, float gravityStrength) {
-        for (auto& p : points) {
-            if (p.fixed || p.dragged) continue;
-            p.ay = gravityEnabled ? gravityStrength * (1.0f + (p.radius - 1.0f) * 0.05f) : 0.0f;
-            p.vx += p.ax * dt;
-            p.vy += p.ay * dt;
-            p.vx *= p.damping;
-            p.vy *= p.damping;
-            p.x += p.vx * dt;
-            p.y += p.vy * dt;
-            if (p.y + p.radius > 720) {
-                p.y = 720 - p.radius;
-                p.vy *= -p.restitution;
-                p.vx *= (1 - p.friction);
-                if (std::abs(p.vy) < 0.1f) p.vy = 0;
-                if (std::abs(p.vx) < 0.01f) p.vx = 0;
-            }
-        }
-
-        for (auto& t : triangles) {
-            for (auto* pt : {&t.point1, &t.point2, &t.point3}) {
-                if (pt->fixed || pt->dragged) continue;
-                pt->ay = gravityEnabled ? gravityStrength * (1.0f + (pt->radius - 1.0f) * 0.05f) : 0.0f;
-                pt->vx += pt->ax * dt;
-                pt->vy += pt->ay * dt;
-                pt->vx *= pt->damping;
-                pt->vy *= pt->damping;
-                pt->x += pt->vx * dt;
-                pt->y += pt->vy * dt;
-                if (pt->y + pt->radius > 720) {
-                    pt->y = 720 - pt->radius;
-                    pt->vy *= -pt->restitution;
-                    pt->vx *= (1 - pt->friction);
-                    if (std::abs(pt->vy) < 0.1f) pt->vy = 0;
-                    if (std::abs(pt->vx) < 0.01f) pt->vx = 0;
-                }
+            S normalX = distance > S(0) ? distX / distance : S(1);
+            S normalY = distance > S(0) ? distY / distance : S(0);
+            S dotProduct = p.vx * normalX + p.vy * normalY;
+            p.vx -= S(2) * dotProduct * normalX;
+            p.vy -= S(2) * dotProduct * normalY;
+            S restitution = materialOf(p).restitution;
+            p.vx *= restitution;
+            p.vy *= restitution;
+        }
+    }
+
+    bool resolveStaticCollision(Point& p, S prevX, S prevY, const Segment& s) {
+        S edgeDx = s.x2 - s.x1;
+        S edgeDy = s.y2 - s.y1;
+        S edgeLengthSquared = edgeDx * edgeDx + edgeDy * edgeDy;
+        if (edgeLengthSquared == S(0)) return false;
+        S edgeLength = scalarSqrt(edgeLengthSquared);
+        S sideBefore = edgeDx * (prevY - s.y1) - edgeDy * (prevX - s.x1);
+        S sideAfter = edgeDx * (p.y - s.y1) - edgeDy * (p.x - s.x1);
+        S projection = ((p.x - s.x1) * edgeDx + (p.y - s.y1) * edgeDy) / edgeLengthSquared;
+        S normalX, normalY, overlap;
+        // Opposite signs, tested directly: the product of two cross products overflows fixed point.
+        bool crossed = (sideBefore > S(0) && sideAfter < S(0)) || (sideBefore < S(0) && sideAfter > S(0));
+        if (crossed && projection >= S(0) && projection <= S(1)) {
+            // The centre crossed the segment this step; push it back to the side it came from.
+            S sign = sideBefore > S(0) ? S(1) : S(-1);
+            normalX = -edgeDy / edgeLength * sign;
+            normalY = edgeDx / edgeLength * sign;
+            overlap = p.radius + scalarAbs(sideAfter) / edgeLength;
+        } else {
+            projection = std::max(S(0), std::min(S(1), projection));
+            S distX = p.x - (s.x1 + projection * edgeDx);
+            S distY = p.y - (s.y1 + projection * edgeDy);
+            S distanceSquared = distX * distX + distY * distY;
+            if (distanceSquared >= p.radius * p.radius) return false;
+            S distance = scalarSqrt(distanceSquared);
+            normalX = distance > S(0) ? distX / distance : -edgeDy / edgeLength;
+            normalY = distance > S(0) ? distY / distance : edgeDx / edgeLength;
+            overlap = p.radius - distance;
+        }
+        p.x += normalX * overlap;
+        p.y += normalY * overlap;
+        S vn = p.vx * normalX + p.vy * normalY;
+        if (vn >= S(0)) return false;
+        S tx = p.vx - vn * normalX;
+        S ty = p.vy - vn * normalY;
+        const auto& material = materialOf(p);
+        p.vx = tx * (S(1) - material.friction) - vn * material.restitution * normalX;
+        p.vy = ty * (S(1) - material.friction) - vn * material.restitution * normalY;
+        return true;
+    }
+
+    // Returns whether any segment set the velocity.
+    bool collideStatic(Point& p, S prevX, S prevY) {
+        if (p.fixed) return false;
+        bool bounced = false;
+        staticGeometry.forEachNear(p.x, p.y, [&](const Segment& s) { bounced |= resolveStaticCollision(p, prevX, prevY, s); });
+        return bounced;
+    }
+
+    template <typename Body>
+    void recycle(Body& body, S cx, S cy) {
+        for (auto* pt : body.vertices()) {
+            pt->x += bounds.spawnX - cx;
+            pt->y += bounds.spawnY - cy;
+            pt->vx = pt->vy = S(0);
+        }
+    }
+
+    void enforceBounds() {
+        if (bounds.policy == BoundsPolicy::None) return;
+        bool cull = bounds.policy == BoundsPolicy::Cull;
+
+        auto outside = [&](const Point& p) { return !bounds.contains(p.x, p.y); };
+        if (cull) {
+            size_t before = points.size();
+            auto culled = [&](const Point& p) {
+                if (!outside(p)) return false;
+                track(p, false);
+                return true;
+            };
+            points.erase(std::remove_if(points.begin(), points.end(), culled), points.end());
+            if (points.size() != before) fluid.invalidate();
+        } else {
+            for (auto& p : points) {
+                if (outside(p)) { p.x = bounds.spawnX; p.y = bounds.spawnY; setVelocity(p, S(0), S(0)); }
             }
-            t.enforceConstraints();
         }
 
-        for (auto& s : squares) {
-            for (auto* pt : {&s.point1, &s.point2, &s.point3, &s.point4}) {
-                if (pt->fixed || pt->dragged) continue;
-                pt->ay = gravityEnabled ? gravityStrength * (1.0f + (pt->radius - 1.0f) * 0.05f) : 0.0f;
-                pt->vx += pt->ax * dt;
-                pt->vy += pt->ay * dt;
-                pt->vx *= pt->damping;
-                pt->vy *= pt->damping;
-                pt->x += pt->vx * dt;
-                pt->y += pt->vy * dt;
-            }
-            float floorY = 720.0f;
-            float minY = std::min({s.point1.y, s.point2.y, s.point3.y, s.point4.y});
-            if (minY + s.point1.radius > floorY) {
-                float correction = floorY - (minY + s.point1.radius);
-                for (auto* pt : {&s.point1, &s.point2, &s.point3, &s.point4}) {
-                    if (pt->fixed) continue;
-                    pt->y += correction;
-                    pt->vy *= -pt->restitution;
-                    pt->vx *= (1 - pt->friction);
-                    if (std::abs(pt->vy) < 0.1f) pt->vy = 0;
-                    if (std::abs(pt->vx) < 0.01f) pt->vx = 0;
-                }
+        auto handleShapes = [&](auto& shapes) {
+            auto leftBounds = [&](auto& shape) {
+                S cx = S(0), cy = S(0);
+                auto verts = shape.vertices();
+                for (auto* pt : verts) { cx += pt->x; cy += pt->y; }
+                cx /= S(static_cast<int>(verts.size()));
+                cy /= S(static_cast<int>(verts.size()));
+                if (bounds.contains(cx, cy)) return false;
+                if (!cull) recycle(shape, cx, cy);
+                else track(shape, false);
+                return cull;
+            };
+            shapes.erase(std::remove_if(shapes.begin(), shapes.end(), leftBounds), shapes.end());
+        };
+        handleShapes(triangles);
+        handleShapes(squares);
+        handleShapes(chains);
+    }
+
+    template <typename A, typename B>
+    bool collidePair(A& a, B& b, Manifold<Point>& manifold) {
+        auto va = a.vertices();
+        auto vb = b.vertices();
+        return collidePolygons(va.data(), static_cast<int>(va.size()), vb.data(), static_cast<int>(vb.size()), manifold, contactMargin);
+    }
+
+    // Shapes are numbered triangles first, then squares, as in the broadphase boxes.
+    bool collideBodies(const BodyPair& pair, Manifold<Point>& manifold) {
+        size_t split = triangles.size();
+        if (pair.b < split) return collidePair(triangles[pair.a], triangles[pair.b], manifold);
+        if (pair.a < split) return collidePair(triangles[pair.a], squares[pair.b - split], manifold);
+        return collidePair(squares[pair.a - split], squares[pair.b - split], manifold);
+    }
+
+    uint32_t shapeId(uint32_t body) const {
+        return body < triangles.size() ? triangles[body].id : squares[body - triangles.size()].id;
+    }
+
+    // The narrowphase only reads the shapes, so pairs are split across threads and the manifolds
+    // gathered per chunk, then concatenated in pair order.
+    void findManifolds() {
+        const auto& pairs = broadphase.pairs;
+        chunkManifolds.resize(threadPool ? threadPool->size() : 1);
+        chunkManifoldBodies.resize(chunkManifolds.size());
+        for (auto& part : chunkManifolds) part.clear();
+        for (auto& part : chunkManifoldBodies) part.clear();
+        parallelFor(threadPool, pairs.size(), [&](size_t begin, size_t end, unsigned chunk) {
+            Manifold<Point> manifold;
+            for (size_t i = begin; i < end; ++i) {
+                if (!collideBodies(pairs[i], manifold)) continue;
+                manifold.vertexBody = manifold.flipped ? pairs[i].a : pairs[i].b;
+                manifold.edgeBody = manifold.flipped ? pairs[i].b : pairs[i].a;
+                chunkManifolds[chunk].push_back(manifold);
+                chunkManifoldBodies[chunk].push_back(pairs[i]);
             }
-            for (int i = 0; i < 10; ++i) s.enforceConstraints();
+        });
+        manifolds.clear();
+        manifoldKeys.clear();
+        manifoldBodies.clear();
+        for (size_t c = 0; c < chunkManifolds.size(); ++c) {
+            manifolds.insert(manifolds.end(), chunkManifolds[c].begin(), chunkManifolds[c].end());
+            manifoldBodies.insert(manifoldBodies.end(), chunkManifoldBodies[c].begin(), chunkManifoldBodies[c].end());
         }
+        for (const auto& pair : manifoldBodies) manifoldKeys.push_back(ContactCache::key(shapeId(pair.a), shapeId(pair.b)));
 
-        for (auto& t : triangles) {
-            for (auto& s : squares) {
-                Point* triPoints[3] = {&t.point1, &t.point2, &t.point3};
-                Point* sqPoints[4] = {&s.point1, &s.point2, &s.point3, &s.point4};
-                for (auto* tp : triPoints) {
-                    for (int i = 0; i < 4; ++i) {
-                        checkAndResolveCollision(*tp, *sqPoints[i], *sqPoints[(i+1)%4]);
-                    }
-                }
+        // Shapes on the floor also get a manifold against the ground, a static body numbered after
+        // the shapes, so the floor holds the bottom of a stack up during the solve as well.
+        uint32_t ground = static_cast<uint32_t>(triangles.size() + squares.size());
+        for (uint32_t body = 0; body < ground; ++body) {
+            Manifold<Point> manifold;
+            withShapeVertices(body, [&](const auto& verts) { collideGround(verts, manifold); });
+            if (manifold.count == 0) continue;
+            manifold.vertexBody = body;
+            manifold.edgeBody = ground;
+            manifolds.push_back(manifold);
+            manifoldBodies.push_back({body, ground});
+            manifoldKeys.push_back(ContactCache::key(shapeId(body), 0));
+        }
+    }
+
+    // Up to the two deepest vertices within `contactMargin` of the floor, pushed straight up.
+    template <typename Vertices>
+    void collideGround(const Vertices& verts, Manifold<Point>& m) const {
+        m.normalX = S(0);
+        m.normalY = S(-1);
+        m.count = 0;
+        for (size_t i = 0; i < verts.size(); ++i) {
+            Point* v = verts[i];
+            S depth = v->y + v->radius - floorY;
+            if (depth <= -contactMargin) continue;
+            Contact<Point> c{v, v, S(0), v, v, S(0), depth, static_cast<int>(i)};
+            if (m.count < 2) {
+                m.contacts[m.count++] = c;
+            } else {
+                int shallow = m.contacts[0].depth < m.contacts[1].depth ? 0 : 1;
+                if (c.depth > m.contacts[shallow].depth) m.contacts[shallow] = c;
+            }
+        }
+    }
+
+    // Greedy colouring in manifold order, so no two manifolds of a colour share a body. The ground
+    // never moves, so it takes no colours. Manifolds that find all 64 colours taken on their bodies
+    // go to a last colour that is solved serially.
+    void colourManifolds() {
+        bodyColours.assign(triangles.size() + squares.size() + 1, 0);
+        manifoldColour.resize(manifolds.size());
+        colourStart.assign(66, 0);
+        for (size_t i = 0; i < manifolds.size(); ++i) {
+            const BodyPair& pair = manifoldBodies[i];
+            uint64_t used = bodyColours[pair.a] | bodyColours[pair.b];
+            int colour = 0;
+            while (colour < 64 && (used >> colour & 1)) ++colour;
+            if (colour < 64) {
+                bodyColours[pair.a] |= uint64_t(1) << colour;
+                if (pair.b + 1 < bodyColours.size()) bodyColours[pair.b] |= uint64_t(1) << colour;
             }
+            manifoldColour[i] = static_cast<uint8_t>(colour);
+            ++colourStart[colour + 1];
+        }
+        for (size_t c = 0; c + 1 < colourStart.size(); ++c) colourStart[c + 1] += colourStart[c];
+        colourOrder.resize(manifolds.size());
+        ContactVector<uint32_t> cursor(colourStart.begin(), colourStart.end() - 1);
+        for (size_t i = 0; i < manifolds.size(); ++i) colourOrder[cursor[manifoldColour[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    // Calls fn(manifold) for every manifold, one colour after another, each colour across threads.
+    template <typename Fn>
+    void forEachManifoldByColour(Fn&& fn) {
+        for (size_t c = 0; c + 1 < colourStart.size(); ++c) {
+            uint32_t first = colourStart[c], count = colourStart[c + 1] - first;
+            if (count == 0) continue;
+            if (c == 64) {
+                for (uint32_t k = 0; k < count; ++k) fn(manifolds[colourOrder[first + k]]);
+                continue;
+            }
+            parallelFor(threadPool, count, [&](size_t begin, size_t end, unsigned) {
+                for (size_t k = begin; k < end; ++k) fn(manifolds[colourOrder[first + k]]);
+            }, 32);
+        }
+    }
+
+    template <typename Fn>
+    void forEachIndex(size_t count, Fn&& fn) {
+        if (!deterministicParallel) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        parallelFor(threadPool, count, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) fn(i);
+        }, 64);
+    }
+
+    // Calls fn(begin, end, block) for consecutive blocks of `blockSize` indices, split across threads
+    // in deterministic parallel mode. A block is always handled whole by one thread.
+    template <typename Fn>
+    void forEachBlock(size_t count, Fn&& fn) {
+        size_t blocks = (count + blockSize - 1) / blockSize;
+        auto run = [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) fn(b * blockSize, std::min(count, (b + 1) * blockSize), b);
+        };
+        if (!deterministicParallel) {
+            run(0, blocks);
+            return;
         }
+        parallelFor(threadPool, blocks, [&](size_t begin, size_t end, unsigned) { run(begin, end); }, 1);
+    }
+
+    // forEachIndex for the integrator, with fn(i, diagnostics). When measuring, each block sums
+    // into its own partial and the partials are merged in block order into the stage's partial,
+    // so the totals come out the same for any thread count.
+    template <bool Measure, typename Fn>
+    void integrateEach(size_t stage, size_t count, Fn&& fn) {
+        if constexpr (Measure) {
+            auto& blocks = blockDiagnostics[stage];
+            blocks.assign((count + blockSize - 1) / blockSize, Diagnostics{});
+            forEachBlock(count, [&](size_t begin, size_t end, size_t block) {
+                for (size_t i = begin; i < end; ++i) fn(i, blocks[block]);
+            });
+            for (const auto& partial : blocks) stageDiagnostics[stage].merge(partial);
+        } else {
+            forEachIndex(count, [&](size_t i) { fn(i, stageDiagnostics[stage]); });
+        }
+    }
+
+    void measure(const Point& p, Diagnostics& d) const { measure(p, p.vx, p.vy, d); }
+
+    void measure(const Point& p, S vx, S vy, Diagnostics& d) const {
+        d.addPoint(materialOf(p).mass, vx, vy, uniformForce.ay + uniformForce.ayPerRadius * p.radius, floorY - p.y);
+    }
 
-        for (auto &s1 : squares) {
-            for (auto &s2 : squares) {
-                if (&s1 == &s2) continue;
-                Point* pts1[4] = {&s1.point1, &s1.point2, &s1.point3, &s1.point4};
-                Point* pts2[4] = {&s2.point1, &s2.point2, &s2.point3, &s2.point4};
-                for (auto* p1 : pts1) {
-                    for (auto* p2 : pts2) {
-                        float dx = p2->x - p1->x;
-                        float dy = p2->y - p1->y;
-                        float distSq = dx*dx + dy*dy;
-                        float minDist = p1->radius + p2->radius;
-                        if (distSq < minDist*minDist) {
-                            float dist = std::sqrt(distSq);
-                            float overlap = 0.5f * (minDist - dist);
-                            if (!p1->fixed) { p1->x -= dx/dist * overlap; p1->y -= dy/dist * overlap; }
-                            if (!p2->fixed) { p2->x += dx/dist * overlap; p2->y += dy/dist * overlap; }
-                            float nx = dx / dist;
-                            float ny = dy / dist;
-                            float p = 2.0f * (p1->vx*nx + p1->vy*ny - p2->vx*nx - p2->vy*ny) / (p1->mass + p2->mass);
-                            if (!p1->fixed) { p1->vx -= p * p2->mass * nx; p1->vy -= p * p2->mass * ny; }
-                            if (!p2->fixed) { p2->vx += p * p1->mass * nx; p2->vy += p * p1->mass * ny; }
-                        }
+    // Broadphase boxes for every shape, triangles first and then squares, padded by the margin.
+    void computeShapeBoxes() {
+        size_t count = triangles.size() + squares.size();
+        broadphase.boxes.resize(count);
+        parallelFor(threadPool, count, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                auto box = [&](const auto& shape) {
+                    auto verts = shape.vertices();
+                    typename BroadphaseT<S>::Box b{verts[0]->x, verts[0]->y, verts[0]->x, verts[0]->y};
+                    for (const auto* pt : verts) {
+                        b.minX = std::min(b.minX, pt->x); b.maxX = std::max(b.maxX, pt->x);
+                        b.minY = std::min(b.minY, pt->y); b.maxY = std::max(b.maxY, pt->y);
                     }
+                    b.minX -= contactMargin; b.minY -= contactMargin;
+                    b.maxX += contactMargin; b.maxY += contactMargin;
+                    return b;
+                };
+                broadphase.boxes[i] = i < triangles.size() ? box(triangles[i]) : box(squares[i - triangles.size()]);
+            }
+        });
+    }
+
+    void collideShapes(S dt) {
+        computeShapeBoxes();
+        broadphase.findPairs(threadPool);
+        findManifolds();
+        if (deterministicParallel) colourManifolds();
+
+        contactCache.beginFrame();
+        if (!manifolds.empty()) solveContacts(dt);
+        for (size_t i = 0; i < manifolds.size(); ++i) contactCache.store(manifoldKeys[i], manifolds[i]);
+        contactCache.evictStale();
+    }
+
+    // Calls fn(vertices) for shape `body`, numbered triangles first as in the broadphase boxes.
+    template <typename Fn>
+    void withShapeVertices(size_t body, Fn&& fn) {
+        if (body < triangles.size()) fn(triangles[body].vertices());
+        else fn(squares[body - triangles.size()].vertices());
+    }
+
+    // Every shape is gathered into a rigid body, the contacts are solved on those, and the result
+    // is scattered back to the vertices, so an impulse at one corner moves the whole shape at once.
+    void solveContacts(S dt) {
+        size_t bodyCount = triangles.size() + squares.size();
+        rigidBodies.assign(bodyCount + 1, RigidBody{});     // the last is the ground
+        RigidBody* bodies = rigidBodies.data();
+        parallelFor(threadPool, bodyCount, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) withShapeVertices(i, [&](const auto& verts) { bodies[i].gather(verts); });
+        });
+        for (size_t i = 0; i < manifolds.size(); ++i) {
+            prepareManifold(manifolds[i], bodies, S(1) / dt, restitutionThreshold);
+            if (warmStarting) contactCache.fetch(manifoldKeys[i], manifolds[i]);
+        }
+        if (deterministicParallel) {
+            if (warmStarting) forEachManifoldByColour([&](Manifold<Point>& m) { warmStartManifold(m, bodies); });
+            for (int iteration = 0; iteration < solverIterations; ++iteration) {
+                forEachManifoldByColour([&](Manifold<Point>& m) { solveManifoldVelocity(m, bodies); });
+            }
+            for (int iteration = 0; iteration < solverIterations; ++iteration) {
+                forEachManifoldByColour([&](Manifold<Point>& m) { solveManifoldPosition(m, bodies); });
+            }
+        } else {
+            if (warmStarting) for (auto& m : manifolds) warmStartManifold(m, bodies);
+            for (int iteration = 0; iteration < solverIterations; ++iteration) {
+                for (auto& m : manifolds) solveManifoldVelocity(m, bodies);
+            }
+            for (int iteration = 0; iteration < solverIterations; ++iteration) {
+                for (const auto& m : manifolds) solveManifoldPosition(m, bodies);
+            }
+        }
+        parallelFor(threadPool, bodyCount, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) withShapeVertices(i, [&](const auto& verts) { bodies[i].scatter(verts); });
+        });
+    }
+
+    // Integrates one point. The flags are fixed per step and body kind, so the common configurations
+    // compile to straight-line code with no per-particle tests for settings that are off. Fixed
+    // (and dragged) points are only tested for in the `AnyFixed` instantiations of `integrate`.
+    template <bool Uniform, bool Local, bool Damping, bool Extra = false>
+    void integratePoint(Point& p, S dt, S ax = S(0), S ay = S(0)) {
+        if constexpr (Uniform) {
+            ax += uniformForce.ax;
+            ay += uniformForce.ay + uniformForce.ayPerRadius * p.radius;
+        }
+        if constexpr (Local) {
+            for (const auto* field : localFields) field->accumulate(p.x, p.y, p.vx, p.vy, ax, ay);
+        }
+        if constexpr (Uniform || Local || Extra) {
+            p.vx += ax * dt;
+            p.vy += ay * dt;
+        }
+        if constexpr (Damping) {
+            S damping = materialOf(p).damping;
+            p.vx *= damping;
+            p.vy *= damping;
+        }
+        p.x += p.vx * dt;
+        p.y += p.vy * dt;
+    }
+
+    // Position Verlet: the displacement since the previous position, held in vx, vy, stands in for
+    // the velocity, so position corrections from the last step carry into this one. Leaves this
+    // step's displacement in vx, vy for the collisions, which respond to it as to a velocity.
+    template <bool Uniform, bool Local, bool Damping, bool Extra = false>
+    void verletPoint(Point& p, S dtSquared, S inverseDt, S ax = S(0), S ay = S(0)) {
+        S dx = p.x - p.vx, dy = p.y - p.vy;
+        if constexpr (Uniform) {
+            ax += uniformForce.ax;
+            ay += uniformForce.ay + uniformForce.ayPerRadius * p.radius;
+        }
+        if constexpr (Local) {
+            for (const auto* field : localFields) field->accumulate(p.x, p.y, dx * inverseDt, dy * inverseDt, ax, ay);
+        }
+        if constexpr (Damping) {
+            S damping = materialOf(p).damping;
+            dx *= damping;
+            dy *= damping;
+        }
+        if constexpr (Uniform || Local || Extra) {
+            dx += ax * dtSquared;
+            dy += ay * dtSquared;
+        }
+        p.x += dx;
+        p.y += dy;
+        p.vx = dx;
+        p.vy = dy;
+    }
+
+    // Returns whether the velocity was set. With vx, vy holding a displacement over `unit` seconds
+    // instead of a velocity, the rest thresholds scale to match; the rest of the response is linear.
+    bool collideFloor(Point& p, S unit = S(1)) {
+        if (p.y + p.radius <= floorY) return false;
+        const auto& material = materialOf(p);
+        p.y = floorY - p.radius;
+        p.vy *= -material.restitution;
+        p.vx *= (S(1) - material.friction);
+        if (scalarAbs(p.vy) < S(0.1) * unit) p.vy = S(0);
+        if (scalarAbs(p.vx) < S(0.01) * unit) p.vx = S(0);
+        return true;
+    }
+
+    // Body kinds for `integrate`; each touches only its own bodies, so they may run concurrently.
+    static constexpr unsigned integratePoints = 1 << pointKind, integrateTriangles = 1 << triangleKind;
+    static constexpr unsigned integrateChains = 1 << chainKind, integrateSquares = 1 << squareKind;
+    static constexpr unsigned integrateAll = 15;
+
+    template <bool Uniform, bool Local, bool Damping, bool AnyFixed, bool Extra, bool Measure>
+    void integrate(S dt, unsigned kinds) {
+        bool verlet = integrator == Integrator::Verlet;
+        S inverseDt = S(1) / dt, dtSquared = dt * dt;
+        if ((kinds & integratePoints) && verlet) integrateEach<Measure>(0, points.size(), [&](size_t i, Diagnostics& d) {
+            Point& p = points[i];
+            bool moving = true;
+            if constexpr (AnyFixed) moving = !p.fixed;
+            S startX = p.x, startY = p.y;     // pinned particles are left at rest
+            if (moving) {
+                if constexpr (Extra) verletPoint<Uniform, Local, Damping, true>(p, dtSquared, inverseDt, extraAx[i], extraAy[i]);
+                else verletPoint<Uniform, Local, Damping>(p, dtSquared, inverseDt);
+                // A bounce sets the displacement outright; anything else only moved the particle.
+                bool bounced = collideFloor(p, dt);
+                bounced |= collideStatic(p, startX, startY);
+                if (bounced) {
+                    startX = p.x - p.vx;
+                    startY = p.y - p.vy;
                 }
             }
+            if constexpr (Measure) measure(p, (p.x - startX) * inverseDt, (p.y - startY) * inverseDt, d);
+            p.vx = startX;
+            p.vy = startY;
+        });
+
+        if ((kinds & integratePoints) && !verlet) integrateEach<Measure>(0, points.size(), [&](size_t i, Diagnostics& d) {
+            Point& p = points[i];
+            bool moving = true;
+            if constexpr (AnyFixed) moving = !p.fixed;
+            if (moving) {
+                S prevX = p.x, prevY = p.y;
+                if constexpr (Extra) integratePoint<Uniform, Local, Damping, true>(p, dt, extraAx[i], extraAy[i]);
+                else integratePoint<Uniform, Local, Damping>(p, dt);
+                collideFloor(p);
+                collideStatic(p, prevX, prevY);
+            }
+            if constexpr (Measure) measure(p, d);
+        });
+
+        if (kinds & integrateTriangles) integrateEach<Measure>(1, triangles.size(), [&](size_t index, Diagnostics& d) {
+            Triangle& t = triangles[index];
+            for (auto* pt : t.vertices()) {
+                if constexpr (AnyFixed) {
+                    if (pt->fixed) continue;
+                }
+                S prevX = pt->x, prevY = pt->y;
+                integratePoint<Uniform, Local, Damping>(*pt, dt);
+                collideFloor(*pt);
+                collideStatic(*pt, prevX, prevY);
+            }
+            t.enforceConstraints();
+            if constexpr (Measure) for (const auto* pt : t.vertices()) measure(*pt, d);
+        });
+
+        if (kinds & integrateChains) integrateEach<Measure>(2, chains.size(), [&](size_t index, Diagnostics& d) {
+            Chain& c = chains[index];
+            c.beginStep();
+            for (auto& pt : c.points) {
+                if constexpr (AnyFixed) {
+                    if (pt.fixed) continue;
+                }
+                integratePoint<Uniform, Local, Damping>(pt, dt);
+            }
+            c.enforceConstraints(dt);
+            for (size_t i = 0; i < c.points.size(); ++i) {
+                if (c.points[i].fixed) continue;
+                collideFloor(c.points[i]);
+                collideStatic(c.points[i], c.startX[i], c.startY[i]);
+            }
+            if constexpr (Measure) {
+                for (const auto& pt : c.points) measure(pt, d);
+                d.addViolation(c.maxStretch());
+            }
+        });
+
+        if (kinds & integrateSquares) integrateEach<Measure>(3, squares.size(), [&](size_t index, Diagnostics& d) {
+            Square& s = squares[index];
+            S prevX[4], prevY[4];
+            auto verts = s.vertices();
+            for (int i = 0; i < 4; ++i) {
+                prevX[i] = verts[i]->x;
+                prevY[i] = verts[i]->y;
+                if constexpr (AnyFixed) {
+                    if (verts[i]->fixed) continue;
+                }
+                integratePoint<Uniform, Local, Damping>(*verts[i], dt);
+            }
+            S maxY = std::max({s.point1.y, s.point2.y, s.point3.y, s.point4.y});
+            if (maxY + s.point1.radius > floorY) {
+                S correction = floorY - (maxY + s.point1.radius);
+                for (auto* pt : verts) {
+                    if (pt->fixed) continue;
+                    const auto& material = materialOf(*pt);
+                    pt->y += correction;
+                    if (pt->vy > restitutionThreshold) pt->vy *= -material.restitution;
+                    else if (pt->vy > S(0)) pt->vy = S(0);
+                    pt->vx *= (S(1) - material.friction);
+                    if (scalarAbs(pt->vy) < S(0.1)) pt->vy = S(0);
+                    if (scalarAbs(pt->vx) < S(0.01)) pt->vx = S(0);
+                }
+            }
+            for (int i = 0; i < 4; ++i) collideStatic(*verts[i], prevX[i], prevY[i]);
+            s.enforceConstraints();
+            if constexpr (Measure) {
+                for (const auto* pt : verts) measure(*pt, d);
+                d.addViolation(s.maxStretch());
+            }
+        });
+    }
+
+    template <bool... Flags, typename... Rest>
+    void dispatchIntegrate(S dt, unsigned kinds, bool flag, Rest... rest) {
+        if (flag) dispatchIntegrate<Flags..., true>(dt, kinds, rest...);
+        else dispatchIntegrate<Flags..., false>(dt, kinds, rest...);
+    }
+
+    template <bool... Flags>
+    void dispatchIntegrate(S dt, unsigned kinds) {
+        integrate<Flags...>(dt, kinds);
+    }
+
+    // Mutual attraction is computed for all free points before integration, in parallel, and the
+    // integrator adds it like any other force.
+    void computeNBodyForces() {
+        nbody.build(points, threadPool);
+        parallelFor(threadPool, points.size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                S ax, ay;
+                nbody.acceleration(points[i].x, points[i].y, static_cast<uint32_t>(i), ax, ay);
+                extraAx[i] += ax;
+                extraAy[i] += ay;
+            }
+        });
+    }
+
+    // Runs a fluid particle against a shape edge through the ordinary edge collision, measured in
+    // the edge's frame, and hands the opposite impulse to the edge's endpoints.
+    void coupleFluidEdge(Point& p, Point& a, Point& b) {
+        S edgeDx = b.x - a.x, edgeDy = b.y - a.y;
+        S edgeLengthSquared = edgeDx * edgeDx + edgeDy * edgeDy;
+        if (edgeLengthSquared == S(0)) return;
+        S t = std::clamp(((p.x - a.x) * edgeDx + (p.y - a.y) * edgeDy) / edgeLengthSquared, S(0), S(1));
+        S edgeVx = a.vx + (b.vx - a.vx) * t;
+        S edgeVy = a.vy + (b.vy - a.vy) * t;
+        S vx = p.vx - edgeVx, vy = p.vy - edgeVy;
+        p.vx = vx; p.vy = vy;
+        checkAndResolveCollision(p, a, b);
+        S dvx = p.vx - vx, dvy = p.vy - vy;
+        p.vx += edgeVx; p.vy += edgeVy;
+        if (dvx == S(0) && dvy == S(0)) return;
+        S mass = materialOf(p).mass;
+        S wa = inverseMass(a) * (S(1) - t) * mass;
+        S wb = inverseMass(b) * t * mass;
+        a.vx -= dvx * wa; a.vy -= dvy * wa;
+        b.vx -= dvx * wb; b.vy -= dvy * wb;
+    }
+
+    void coupleFluid() {
+        fluid.refresh(points, threadPool);
+        // The edge collision works with velocities, so Verlet particles hold theirs for the call.
+        auto couple = [&](Point& p, Point& a, Point& b) {
+            if (!pointsHoldPrevious) return coupleFluidEdge(p, a, b);
+            p.vx = (p.x - p.vx) / verletDt;
+            p.vy = (p.y - p.vy) / verletDt;
+            coupleFluidEdge(p, a, b);
+            p.vx = p.x - p.vx * verletDt;
+            p.vy = p.y - p.vy * verletDt;
+        };
+        auto coupleShape = [&](auto& shape) {
+            auto verts = shape.vertices();
+            for (size_t e = 0; e < verts.size(); ++e) {
+                Point& a = *verts[e];
+                Point& b = *verts[(e + 1) % verts.size()];
+                fluid.forEachNear(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.x, b.x), std::max(a.y, b.y),
+                    [&](uint32_t i) { couple(points[i], a, b); });
+            }
+        };
+        for (auto& t : triangles) coupleShape(t);
+        for (auto& s : squares) coupleShape(s);
+    }
+
+    void prepareForceFields() {
+        uniformForce = reduceUniformFields(forceFields);
+        localFields.clear();
+        for (const auto& field : forceFields) {
+            if (field.enabled && !field.isUniform()) localFields.push_back(&field);
         }
     }
+
+    // Advances by dt in `substeps` equal steps. Stiff fluids need the shorter steps; everything else
+    // is happy with one. Damping is applied per substep.
+    void update(S dt) {
+        if (!staticGeometry.built) staticGeometry.build();
+        S h = dt / S(std::max(substeps, 1));
+        for (int i = 0; i < std::max(substeps, 1); ++i) step(h);
+    }
+
+    // What a step needs to know up front, from the flag counts and force fields.
+    struct StepPlan {
+        bool nbodyActive, fluidActive;
+        bool extra() const { return nbodyActive || fluidActive; }
+    };
+
+    StepPlan planStep() {
+        StepPlan plan;
+        prepareForceFields();
+        plan.nbodyActive = nbody.enabled && points.size() > 1;
+        plan.fluidActive = fluid.enabled && !points.empty();
+        if (plan.extra()) {
+            extraAx.assign(points.size(), S(0));
+            extraAy.assign(points.size(), S(0));
+        }
+        stageDiagnostics.fill(Diagnostics{});
+        return plan;
+    }
+
+    // Each kind gets the instantiation its own flag counts call for, so one pinned rope vertex
+    // does not add fixed-point tests to every square.
+    void integrateKinds(S dt, const StepPlan& plan, unsigned kinds) {
+        for (size_t kind = 0; kind < flagCounts.size(); ++kind) {
+            if (!(kinds & (1u << kind))) continue;
+            const FlagCounts& counts = flagCounts[kind];
+            dispatchIntegrate(dt, 1u << kind, uniformForce.active(), !localFields.empty(), counts.damped > 0,
+                              counts.fixed > 0, kind == pointKind && plan.extra(), diagnosticsEnabled);
+        }
+    }
+
+    void step(S dt) {
+        bool verlet = integrator == Integrator::Verlet;
+        if (pointsHoldPrevious && (!verlet || dt != verletDt)) storeVelocities();
+        if (verlet && !pointsHoldPrevious) storePreviousPositions(dt);
+        StepPlan plan = planStep();
+        if (jobGraphEnabled) {
+            stepGraph(dt, plan);
+        } else {
+            if (plan.nbodyActive) computeNBodyForces();
+            if (plan.fluidActive) fluid.computeForces(points, threadPool, extraAx, extraAy, verletInverseDt());
+            integrateKinds(dt, plan, integrateAll);
+            collideShapes(dt);
+            if (plan.fluidActive && (!triangles.empty() || !squares.empty())) coupleFluid();
+            enforceBounds();
+        }
+        diagnostics = Diagnostics{};
+        for (const auto& partial : stageDiagnostics) diagnostics.merge(partial);
+    }
+
+    // The stages of `step` as a dependency graph. N-body and fluid forces both add into extraAx, so
+    // they run one after the other; shape contacts only wait for the shapes they collide.
+    void stepGraph(S dt, const StepPlan& plan) {
+        constexpr uint32_t none = JobGraph::none;
+        JobGraph& graph = jobGraph;
+        graph.clear();
+        uint32_t nbodyJob = plan.nbodyActive ? graph.add("n-body", [&] { computeNBodyForces(); }) : none;
+        uint32_t fluidJob = plan.fluidActive
+            ? graph.add("fluid forces", [&] { fluid.computeForces(points, threadPool, extraAx, extraAy, verletInverseDt()); }, {nbodyJob})
+            : none;
+        uint32_t pointsJob = graph.add("points", [&] { integrateKinds(dt, plan, integratePoints); }, {nbodyJob, fluidJob});
+        uint32_t trianglesJob = graph.add("triangles", [&] { integrateKinds(dt, plan, integrateTriangles); });
+        uint32_t chainsJob = graph.add("chains", [&] { integrateKinds(dt, plan, integrateChains); });
+        uint32_t squaresJob = graph.add("squares", [&] { integrateKinds(dt, plan, integrateSquares); });
+        uint32_t contactsJob = graph.add("shape contacts", [&] { collideShapes(dt); }, {trianglesJob, squaresJob});
+        uint32_t couplingJob = plan.fluidActive && (!triangles.empty() || !squares.empty())
+            ? graph.add("fluid coupling", [&] { coupleFluid(); }, {pointsJob, contactsJob})
+            : none;
+        graph.add("bounds", [&] { enforceBounds(); }, {pointsJob, chainsJob, contactsJob, couplingJob});
+        graph.run(threadPool);
+    }
 };
+
+using Point = PointT<Real>;
+using Square = SquareT<Real>;
+using Triangle = TriangleT<Real>;
+using Chain = ChainT<Real>;
+using ParticleSystem = ParticleSystemT<Real>;
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads sharing one task queue. `run` calls fn(t) once for every t in
+// [0, size()), the calling thread taking t = 0, and returns when all of them have finished. A
+// thread waiting on its own tasks runs queued ones meanwhile, so tasks may call `run` again and
+// idle threads sleep on a condition variable rather than spinning.
+struct ThreadPool {
+    // Counts the unfinished tasks a caller of `wait` is waiting for.
+    struct Batch {
+        unsigned pending = 0;
+    };
+
+    struct Task {
+        std::function<void()> fn;
+        Batch* batch;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // a task was queued, a batch finished, or the pool is stopping
+    std::deque<Task> tasks;
+    bool stopping = false;
+
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency()) {
+        threadCount = std::max(1u, threadCount);
+        for (unsigned i = 1; i < threadCount; ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    void run(const std::function<void(unsigned)>& fn) {
+        if (workers.empty()) {
+            fn(0);
+            return;
+        }
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (unsigned t = 1; t < size(); ++t) push(batch, [&fn, t] { fn(t); });
+        }
+        wake.notify_all();
+        fn(0);
+        wait(batch);
+    }
+
+    // Queues a task counted in `batch`; some thread runs it once a worker or a waiter is free.
+    void submit(Batch& batch, std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            push(batch, std::move(fn));
+        }
+        wake.notify_one();
+    }
+
+    // Runs queued tasks, anyone's, until every task of `batch` has finished.
+    void wait(Batch& batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (batch.pending > 0) {
+            if (tasks.empty()) {
+                wake.wait(lock);
+                continue;
+            }
+            execute(lock);
+        }
+    }
+
+    void push(Batch& batch, std::function<void()> fn) {
+        ++batch.pending;
+        tasks.push_back(Task{std::move(fn), &batch});
+    }
+
+    // Pops the front task and runs it unlocked; `lock` is held again on return.
+    void execute(std::unique_lock<std::mutex>& lock) {
+        Task task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task.fn();
+        lock.lock();
+        if (--task.batch->pending == 0) wake.notify_all();
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || !tasks.empty(); });
+            if (stopping) return;
+            execute(lock);
+        }
+    }
+};
+
+// Splits [0, count) into contiguous chunks, at most one per thread and none smaller than `grain`,
+// and calls fn(begin, end, chunk). Chunk boundaries depend only on count and the chunk count, so
+// per-chunk results can be combined in a fixed order. Runs inline when `pool` is null.
+template <typename Fn>
+void parallelFor(ThreadPool* pool, size_t count, Fn&& fn, size_t grain = 256) {
+    size_t chunks = pool ? std::min<size_t>(pool->size(), std::max<size_t>(1, count / std::max<size_t>(1, grain))) : 1;
+    if (chunks <= 1) {
+        if (count > 0) fn(size_t(0), count, 0u);
+        return;
+    }
+    pool->run([&](unsigned t) {
+        if (t >= chunks) return;
+        size_t begin = count * t / chunks;
+        size_t end = count * (t + 1) / chunks;
+        if (begin < end) fn(begin, end, t);
+    });
+}
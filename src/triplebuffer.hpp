@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer triple buffer. The writer fills `writeSlot()` and
+// publishes it; the reader calls `acquire()` and then reads `readSlot()`. Neither side ever waits:
+// the writer always has a free slot and the reader always holds the newest complete one.
+template <typename T>
+struct TripleBuffer {
+    static constexpr uint8_t indexMask = 3;
+    static constexpr uint8_t freshBit = 4;
+
+    T slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    T& writeSlot() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(static_cast<uint8_t>(back | freshBit), std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Swaps in the newest published slot, if there is one the reader has not seen yet.
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T& readSlot() const { return slots[front]; }
+};
@@ -0,0 +1,54 @@
+#include "../src/bouncylabs.h"
+#include <stdio.h>
+
+/* Drives the shared library from plain C: spawns bodies, round-trips positions through caller
+ * buffers and checks that a step moves particles under gravity. */
+
+#define COUNT 64
+
+static int fail(const char* what) {
+    printf("FAIL: %s\n", what);
+    return 1;
+}
+
+int main(void) {
+    float x[COUNT], y[COUNT], vx[COUNT], vy[COUNT];
+    bl_handle handles[COUNT];
+    bl_stats stats;
+    bl_world* world;
+    size_t i, n;
+
+    if (bl_api_version() != BL_API_VERSION) return fail("version");
+    world = bl_world_create(2);
+    bl_world_add_wall(world, 0.0f, 0.0f, 1280.0f, 720.0f);
+    bl_world_set_gravity(world, 98.0f);
+    for (i = 0; i < COUNT; ++i) bl_spawn_particle(world, 20.0f + 15.0f * (float)i, 100.0f, 3.0f, 1.0f);
+    bl_spawn_square(world, 300.0f, 300.0f, 40.0f);
+    bl_spawn_triangle(world, 500.0f, 300.0f, 40.0f);
+    bl_spawn_rope(world, 600.0f, 50.0f, 900.0f, 50.0f, 30, 1);
+
+    n = bl_get_handles(world, handles, COUNT);
+    if (n != COUNT || handles[0] == 0) return fail("handles");
+
+    n = bl_get_positions(world, x, y, COUNT);
+    for (i = 0; i < n; ++i) y[i] = 200.0f;
+    if (bl_set_positions(world, NULL, y, COUNT) != COUNT) return fail("set positions");
+    for (i = 0; i < n; ++i) vx[i] = vy[i] = 0.0f;
+    bl_set_velocities(world, vx, vy, COUNT);
+
+    for (i = 0; i < 30; ++i) bl_world_step(world, 0.016f);
+    bl_get_positions(world, x, y, COUNT);
+    bl_get_velocities(world, vx, vy, COUNT);
+    for (i = 0; i < COUNT; ++i) {
+        if (!(y[i] > 200.0f) || !(vy[i] > 0.0f)) return fail("particles did not fall");
+    }
+
+    bl_world_get_stats(world, &stats);
+    if (stats.particles != COUNT || stats.squares != 1 || stats.triangles != 1 || stats.chains != 1 || stats.steps != 30)
+        return fail("stats");
+    if (!bl_remove(world, handles[0]) || bl_remove(world, handles[0])) return fail("remove");
+
+    bl_world_destroy(world);
+    printf("capi: ok\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "../src/scenes.hpp"
+#include "../src/fixed.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Steps the same mixed scene in deterministic parallel mode at 1, 4 and 16 threads and checks
+// that the final states hash identically. The fixed-point hash is also the one to compare between
+// machines, since it does not depend on the compiler or CPU. The energy diagnostics are on and
+// hashed too, since their block-ordered sums must not depend on the thread count either. The
+// last run schedules the step as a job graph, whose stages touch disjoint bodies, so it must
+// reproduce the same hash.
+
+template <typename S>
+void buildMixedScene(ParticleSystemT<S>& world, bool fluid) {
+    world.deterministicParallel = true;
+    world.diagnosticsEnabled = true;
+    world.staticGeometry.addWall(S(0), S(0), S(1280), S(720));
+    world.addForceField(ForceFieldT<S>::gravity(S(98)));
+    world.addForceField(ForceFieldT<S>::vortex(S(640), S(360), S(40), S(300)));
+    for (int i = 0; i < 200; ++i) {
+        S x = S(40 + (i % 20) * 30);
+        S y = S(80 + (i / 20) * 30);
+        if (i % 2 == 0) world.addSquare(makeSquare(x, y, S(20)));
+        else world.addTriangle(makeTriangle(x, y, S(20)));
+    }
+    world.fluid.enabled = fluid;
+    MaterialT<S> water;
+    water.restitution = S(0.1);
+    uint16_t material = addMaterial(water);
+    for (int i = 0; i < 400; ++i) {
+        PointT<S> p{S(800) + S(8) * S(i % 20), S(100) + S(8) * S(i / 20), S(4), S(0), S(0)};
+        p.material = material;
+        world.add(p);
+    }
+    world.addChain(ChainT<S>::between(S(700), S(20), S(1000), S(20), 60, S(2)));
+}
+
+template <typename S>
+uint64_t hashState(const ParticleSystemT<S>& world) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&](S value) {
+        unsigned char bytes[sizeof(S)];
+        std::memcpy(bytes, &value, sizeof(S));
+        for (unsigned char b : bytes) hash = (hash ^ b) * 1099511628211ull;
+    };
+    auto mixPoint = [&](const PointT<S>& p) { mix(p.x); mix(p.y); mix(p.vx); mix(p.vy); };
+    for (const auto& p : world.points) mixPoint(p);
+    for (const auto& t : world.triangles) for (const auto* p : t.vertices()) mixPoint(*p);
+    for (const auto& s : world.squares) for (const auto* p : s.vertices()) mixPoint(*p);
+    for (const auto& c : world.chains) for (const auto& p : c.points) mixPoint(p);
+    const auto& d = world.diagnostics;
+    for (S value : {d.kineticEnergy, d.potentialEnergy, d.momentumX, d.momentumY, d.maxConstraintViolation}) mix(value);
+    return hash;
+}
+
+template <typename S>
+bool checkScalar(const char* name, int steps, bool fluid = true) {
+    uint64_t first = 0;
+    bool ok = true;
+    struct Run { unsigned threads; bool jobGraph; };
+    for (Run run : {Run{1, false}, Run{4, false}, Run{16, false}, Run{4, true}}) {
+        unsigned threads = run.threads;
+        ThreadPool pool(threads);
+        ParticleSystemT<S> world;
+        world.threadPool = &pool;
+        world.jobGraphEnabled = run.jobGraph;
+        buildMixedScene(world, fluid);
+        for (int i = 0; i < steps; ++i) world.update(S(0.016));
+        uint64_t hash = hashState(world);
+        std::printf("%-6s %2u threads%s  %016llx\n", name, threads, run.jobGraph ? " (job graph)" : "",
+                    static_cast<unsigned long long>(hash));
+        if (threads == 1) first = hash;
+        else ok &= hash == first;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int steps = argc > 1 ? std::atoi(argv[1]) : 10000;
+    bool ok = checkScalar<float>("float", steps);
+    ok &= checkScalar<double>("double", steps);
+    ok &= checkScalar<Fixed>("fixed", steps, false);
+    std::printf(ok ? "deterministic\n" : "MISMATCH\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include "../src/structures.hpp"
+#include "../src/scenes.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Performance regression gate: steps one bench scene single-threaded and compares its median step
+// time with the checked-in baseline, failing when it is more than `--margin` slower. Each repeat
+// builds a fresh world, warms it up and takes the median of its steps; the reported time is the
+// median over repeats. `--update` records the measured time as the new baseline instead.
+//
+//   BouncyLabsPerfTest --baseline tests/perf_baseline.txt --scene shapes --margin 0.25
+
+struct Baseline {
+    std::string scene;
+    int count;
+    double medianMs;
+};
+
+static std::vector<Baseline> readBaselines(const std::string& path) {
+    std::vector<Baseline> entries;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        Baseline b;
+        if (fields >> b.scene >> b.count >> b.medianMs) entries.push_back(b);
+    }
+    return entries;
+}
+
+static bool writeBaselines(const std::string& path, const std::vector<Baseline>& entries) {
+    std::ofstream file(path);
+    file << "# scene count median_ms  (single-threaded, float; regenerate with BouncyLabsPerfTest --update)\n";
+    for (const auto& b : entries) file << b.scene << ' ' << b.count << ' ' << b.medianMs << '\n';
+    return static_cast<bool>(file);
+}
+
+static bool pinToCpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static double measure(const std::string& scene, int count, int warmup, int steps) {
+    ParticleSystemT<float> world;
+    buildScene(world, scene, count);
+    for (int i = 0; i < warmup; ++i) world.update(0.016f);
+    std::vector<double> samples;
+    samples.reserve(steps);
+    for (int i = 0; i < steps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        world.update(0.016f);
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return median(samples);
+}
+
+int main(int argc, char** argv) {
+    std::string baselinePath = "perf_baseline.txt";
+    std::string scene = "shapes";
+    int count = 0;
+    int warmup = 30;
+    int steps = 100;
+    int repeats = 5;
+    int cpu = 0;
+    double margin = 0.25;
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--baseline") && i + 1 < argc) baselinePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--scene") && i + 1 < argc) scene = argv[++i];
+        else if (!std::strcmp(argv[i], "--count") && i + 1 < argc) count = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--warmup") && i + 1 < argc) warmup = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--steps") && i + 1 < argc) steps = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--repeats") && i + 1 < argc) repeats = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--cpu") && i + 1 < argc) cpu = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--margin") && i + 1 < argc) margin = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--update")) update = true;
+    }
+
+    std::vector<Baseline> baselines = readBaselines(baselinePath);
+    auto entry = std::find_if(baselines.begin(), baselines.end(), [&](const Baseline& b) { return b.scene == scene; });
+    if (count == 0) count = entry != baselines.end() ? entry->count : 400;
+    if (cpu >= 0 && !pinToCpu(cpu)) std::printf("%s: could not pin to cpu %d, timings may be noisier\n", scene.c_str(), cpu);
+
+    std::vector<double> medians;
+    for (int r = 0; r < repeats; ++r) medians.push_back(measure(scene, count, warmup, steps));
+    double measured = median(medians);
+
+    if (update) {
+        if (entry != baselines.end()) *entry = {scene, count, measured};
+        else baselines.push_back({scene, count, measured});
+        if (!writeBaselines(baselinePath, baselines)) {
+            std::printf("%s: could not write %s\n", scene.c_str(), baselinePath.c_str());
+            return 1;
+        }
+        std::printf("%s (%d): baseline set to %.4f ms\n", scene.c_str(), count, measured);
+        return 0;
+    }
+    if (entry == baselines.end()) {
+        std::printf("%s: no baseline in %s\n", scene.c_str(), baselinePath.c_str());
+        return 1;
+    }
+    if (entry->count != count) {
+        std::printf("%s: baseline is for %d bodies, measured %d\n", scene.c_str(), entry->count, count);
+        return 1;
+    }
+
+    double limit = entry->medianMs * (1.0 + margin);
+    bool pass = measured <= limit;
+    std::printf("%s (%d): median %.4f ms, baseline %.4f ms, limit %.4f ms (+%.0f%%): %s\n", scene.c_str(), count,
+                measured, entry->medianMs, limit, margin * 100.0, pass ? "ok" : "REGRESSION");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#include "../src/scenes.hpp"
+#include "../src/fixed.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Steps the bench's stack of eight boxes with one and with four solver iterations and checks that
+// it is still standing at the end: every box level, centred over the one below and close to at rest.
+
+template <typename S>
+bool checkStack(const char* name, int iterations, int steps) {
+    ParticleSystemT<S> world;
+    world.solverIterations = iterations;
+    buildScene(world, "stack", 8);
+    for (int i = 0; i < steps; ++i) world.update(S(0.016));
+
+    bool ok = true;
+    double previousY = 1e9, worstTilt = 0, worstOffset = 0, worstSpeed = 0;
+    for (const auto& square : world.squares) {
+        double cx = 0, cy = 0;
+        for (const auto* p : square.vertices()) {
+            cx += static_cast<double>(p->x) / 4;
+            cy += static_cast<double>(p->y) / 4;
+            worstSpeed = std::max(worstSpeed, std::hypot(static_cast<double>(p->vx), static_cast<double>(p->vy)));
+        }
+        worstTilt = std::max(worstTilt, std::fabs(static_cast<double>(square.point2.y - square.point1.y)));
+        worstOffset = std::max(worstOffset, std::fabs(cx - 625));
+        if (&square != &world.squares.front()) ok &= previousY - cy > 45 && previousY - cy < 55;
+        previousY = cy;
+    }
+    ok &= worstTilt < 1 && worstOffset < 1 && worstSpeed < 1;
+    std::printf("%-6s %d iteration%s  top %.2f  tilt %.3f  offset %.3f  speed %.3f  %s\n", name, iterations,
+                iterations == 1 ? " " : "s", previousY, worstTilt, worstOffset, worstSpeed, ok ? "standing" : "FELL");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int steps = argc > 1 ? std::atoi(argv[1]) : 2500;
+    bool ok = true;
+    for (int iterations : {1, 4}) {
+        ok &= checkStack<float>("float", iterations, steps);
+        ok &= checkStack<double>("double", iterations, steps);
+        ok &= checkStack<Fixed>("fixed", iterations, steps);
+    }
+    return ok ? 0 : 1;
+}